@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <casadi/casadi.hpp>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <string>
+#include <vector>
+
+#include "backends.h"          // NLP solver backends
+#include "race_car.h"          // Race-car OCP
+#include "trajectory_writer.h" // Binary trajectory output
+
+using namespace casadi;
+
+/* Result of one backend on the race-car OCP */
+struct backend_run {
+  bool success = false;           // every solve converged
+  std::string status = "-";       // return status or exception message
+  double iter = std::nan("");     // iterations of the last solve
+  double first_ms = std::nan(""); // first solve, with the solver's setup
+  double solve_ms = std::nan(""); // median of the repeated solves
+  double T = std::nan("");        // optimal final time, the objective
+};
+
+static backend_run run(const Backend &b, int N, int repeats) {
+  using ms = std::chrono::duration<double, std::milli>;
+  backend_run r;
+  RaceCarOCP ocp(N, vehicle{}, constraints{}, b.dynamics);
+  auto &opti = ocp.opti;
+  ocp.set_case(obstacle{}, vehicle{}.mu);
+  ocp.set_initial(initial_guess{});
+
+  // every solve starts from the same initial guess, opti keeps it
+  std::vector<double> times;
+  try {
+    opti.solver(b.plugin, b.opts);
+    for (int i = 0; i <= repeats; ++i) {
+      auto start = std::chrono::steady_clock::now();
+      auto sol = opti.solve();
+      times.push_back(ms(std::chrono::steady_clock::now() - start).count());
+      r.T = static_cast<double>(sol.value(ocp.T));
+    }
+    r.success = true;
+  } catch (const std::exception &e) {
+    r.status = e.what();
+    r.status = r.status.substr(0, r.status.find('\n')); // first line
+    r.T = std::nan("");
+  }
+
+  // statistics of the last solve, none if the plugin failed to load
+  try {
+    Dict stats = opti.stats();
+    if (stats.count("return_status"))
+      r.status = stats.at("return_status").as_string();
+    if (stats.count("iter_count"))
+      r.iter = stats.at("iter_count").as_int();
+  } catch (const std::exception &) {
+  }
+  if (!times.empty()) {
+    r.first_ms = times.front();
+    times.erase(times.begin());
+  }
+  if (!times.empty()) {
+    std::nth_element(times.begin(), times.begin() + times.size() / 2,
+                     times.end());
+    r.solve_ms = times[times.size() / 2];
+  }
+  return r;
+}
+
+/*! Main function, usage: casadi_backends [repeats] [backend ...]
+ *
+ * Runs the race-car OCP through each NLP backend of backends.h, all of them
+ * by default, and records iterations, the wall time of the first solve
+ * (including the solver's setup) and the median of `repeats` further solves
+ * (default 5), and the optimal final time T. A backend that is missing from
+ * the CasADi build, e.g. fatrop or the HSL solvers, fails with its message
+ * and the others still run. Results go to casadi_backends_cpp.npz. */
+int main(int argc, char *argv[]) {
+
+  int N = 40; // number of control intervals
+  int repeats = 5;
+  std::vector<std::string> names;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (!arg.empty() && std::isdigit(static_cast<unsigned char>(arg[0])))
+      repeats = std::atoi(argv[i]);
+    else
+      names.push_back(arg);
+  }
+  if (names.empty())
+    names = backend_names();
+
+  std::printf("%-11s %5s %10s %10s %8s  %s\n", "backend", "iter", "first ms",
+              "solve ms", "T", "status");
+  NpzWriter npz("casadi_backends_cpp");
+  npz.write("Nsmp", N);
+  for (const std::string &name : names) {
+    backend_run r = run(backend(name), N, repeats);
+    std::printf("%-11s %5.0f %10.1f %10.1f %8.4f  %s\n", name.c_str(), r.iter,
+                r.first_ms, r.solve_ms, r.T, r.status.c_str());
+
+    std::string key = name;
+    std::replace(key.begin(), key.end(), '-', '_');
+    npz.write(key + "_success", r.success ? 1.0 : 0.0);
+    npz.write(key + "_iter", r.iter);
+    npz.write(key + "_first_ms", r.first_ms);
+    npz.write(key + "_solve_ms", r.solve_ms);
+    npz.write(key + "_T", r.T);
+  }
+
+  return 0;
+}
@@ -0,0 +1,247 @@
+#include <algorithm>
+#include <atomic>
+#include <casadi/casadi.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <eigen3/Eigen/Dense>
+#include <exception>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "backends.h"          // NLP solver backends
+#include "parameter_sweep.h"   // Multi-threaded sweep runner
+#include "race_car.h"          // Race-car OCP
+#include "trajectory_writer.h" // Binary trajectory output
+
+using namespace casadi;
+
+/* One case of the batch */
+struct race_case {
+  obstacle obs;
+  double mu;
+};
+
+/* Best solution of one case over the initial guesses */
+struct case_result {
+  double T = std::numeric_limits<double>::quiet_NaN(); // final time
+  int start = -1;           // winning initial guess, -1 if none converged
+  int n_converged = 0;      // initial guesses that converged
+  std::vector<double> X, U; // trajectories, column-major 4 x (N+1), 2 x N
+};
+
+/* One worker's context for the raw, buffer-based call of the solver
+ * Function: its own memory object and work vectors. Reference counts of
+ * CasADi objects are not atomic, so the workers neither copy the Function
+ * nor build DMs, and these are all created before the threads start. */
+struct SolverWorker {
+  explicit SolverWorker(const Function &f)
+      : mem(f.checkout()), arg(f.sz_arg()), res(f.sz_res()), iw(f.sz_iw()),
+        w(f.sz_w()), out(f.n_out()) {
+    for (casadi_int i = 0; i < f.n_out(); ++i) {
+      out[i].resize(f.nnz_out(i));
+      res[i] = out[i].data();
+    }
+  }
+
+  int mem;                              // checked-out memory object
+  std::vector<const double *> arg;      // input pointers
+  std::vector<double *> res;            // output pointers, into out
+  std::vector<casadi_int> iw;           // integer work vector
+  std::vector<double> w;                // real work vector
+  std::vector<std::vector<double>> out; // outputs, nonzeros
+};
+
+/*! Main function, usage:
+ *   casadi_batch [n_threads] [--codegen] [--solver=NAME]
+ *
+ * Solves the race-car OCP for a grid of obstacle geometries and friction
+ * coefficients. The NLP is built once as a parametric function, each worker
+ * thread calls it on its own memory object and work vectors. The elliptic
+ * obstacle makes the problem nonconvex, so every case is solved from
+ * several initial guesses and the fastest converged one is kept. All cases
+ * go to casadi_batch_cpp.npz. --codegen solves on compiled NLP callbacks,
+ * see nlp_cache.h. --solver picks the backend, see backends.h; the default
+ * is sqp-qrqp, which runs in parallel. Backends that are not thread-safe,
+ * IPOPT with MUMPS among them, run in a single thread. */
+int main(int argc, char *argv[]) {
+
+  int N = 40; // number of control intervals
+
+  // case grid, obstacle geometry and friction
+  std::vector<race_case> cases;
+  for (double R1 : {3.0, 4.0, 5.0})
+    for (double R2 : {1.5, 2.0, 2.5})
+      for (double p : {4.0, 6.0, 8.0})
+        for (double Xa : {40.0, 50.0, 60.0})
+          for (double mu : {0.6, 0.8, 1.0})
+            cases.push_back({obstacle{Xa, R1, R2, p}, mu});
+
+  // initial guesses: lane, final time, longitudinal force
+  const std::vector<initial_guess> starts = {
+      {1.0, 1.0, 1000.0}, {3.0, 5.0, 1000.0}, {4.5, 10.0, 0.0}};
+
+  SweepOptions sweep;
+  bool codegen = false;
+  for (int i = 1; i < argc; ++i) {
+    if (std::string(argv[i]) == "--codegen")
+      codegen = true;
+    else if (std::string(argv[i]).rfind("--", 0) != 0)
+      sweep.n_threads = std::atoi(argv[i]);
+  }
+  // sqp-qrqp by default, the default ipopt of the other programs would
+  // serialize the batch
+  const Backend solver_backend = backend(solver_arg(argc, argv, "sqp-qrqp"));
+  if (codegen)
+    check_codegen(solver_backend);
+  if (!solver_backend.thread_safe && sweep.n_threads != 1) {
+    std::cout << solver_backend.name
+              << " is not thread-safe, running in one thread" << std::endl;
+    sweep.n_threads = 1;
+  }
+  if (sweep.n_threads == 0)
+    sweep.n_threads = std::max(1u, std::thread::hardware_concurrency());
+  sweep.n_threads = std::min<size_t>(sweep.n_threads, cases.size());
+  std::cout << cases.size() << " cases, " << solver_backend.name << " in "
+            << sweep.n_threads << " threads" << std::endl;
+
+  // build the NLP once, the workers below each check out a solver memory
+  RaceCarOCP ocp(N, vehicle{}, constraints{}, solver_backend.dynamics);
+  Dict opts = solver_backend.opts;
+  opts["error_on_fail"] = true; // failed solves throw, see below
+  Function solver;
+  if (codegen) {
+    solver = ocp.to_compiled_function("race_car", solver_backend.plugin, opts);
+  } else {
+    ocp.opti.solver(solver_backend.plugin, opts);
+    solver = ocp.to_function("race_car");
+  }
+
+  // arguments of every case and initial guess, packed in input order
+  std::vector<std::vector<double>> args(cases.size() * starts.size());
+  std::vector<size_t> offset(solver.n_in() + 1, 0);
+  for (casadi_int i = 0; i < solver.n_in(); ++i)
+    offset[i + 1] = offset[i] + solver.nnz_in(i);
+  for (size_t c = 0; c < cases.size(); ++c) {
+    for (size_t s = 0; s < starts.size(); ++s) {
+      DMDict a = ocp.arguments(cases[c].obs, cases[c].mu, starts[s]);
+      std::vector<double> &packed = args[c * starts.size() + s];
+      packed.reserve(offset.back());
+      for (casadi_int i = 0; i < solver.n_in(); ++i) {
+        const std::vector<double> &nz = a.at(solver.name_in(i)).nonzeros();
+        packed.insert(packed.end(), nz.begin(), nz.end());
+      }
+    }
+  }
+  const casadi_int i_T = solver.index_out("T"), i_X = solver.index_out("X"),
+                   i_U = solver.index_out("U");
+
+  // one context per thread, handed out as the threads start
+  std::vector<SolverWorker> workers;
+  workers.reserve(sweep.n_threads);
+  for (unsigned w = 0; w < sweep.n_threads; ++w)
+    workers.emplace_back(solver);
+  std::atomic<size_t> next_worker{0};
+
+  sweep.progress = [](size_t done, size_t total, double elapsed) {
+    std::cout << done << "/" << total << " cases, " << elapsed << " s"
+              << std::endl;
+  };
+
+  auto start = std::chrono::steady_clock::now();
+  auto results = run_sweep<case_result>(
+      cases.size(), [&] { return &workers[next_worker++]; },
+      [&](SolverWorker *w, size_t job) {
+        case_result best;
+        for (size_t s = 0; s < starts.size(); ++s) {
+          const std::vector<double> &a = args[job * starts.size() + s];
+          for (casadi_int i = 0; i < solver.n_in(); ++i)
+            w->arg[i] = a.data() + offset[i];
+          try {
+            if (solver(w->arg.data(), w->res.data(), w->iw.data(),
+                       w->w.data(), w->mem))
+              continue;
+          } catch (const std::exception &) {
+            continue; // infeasible or not converged from this guess
+          }
+          ++best.n_converged;
+          double T = w->out[i_T][0];
+          if (best.start < 0 || T < best.T) {
+            best.T = T;
+            best.start = static_cast<int>(s);
+            best.X = w->out[i_X];
+            best.U = w->out[i_U];
+          }
+        }
+        return best;
+      },
+      sweep);
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  for (SolverWorker &w : workers)
+    solver.release(w.mem);
+
+  // ---- summary ----
+  size_t n_solved = 0, n_rescued = 0;
+  for (const case_result &r : results) {
+    n_solved += r.start >= 0;
+    n_rescued += r.start > 0;
+  }
+  std::cout << n_solved << "/" << cases.size() << " cases solved in "
+            << elapsed.count() << " s, " << n_rescued
+            << " improved by a later initial guess" << std::endl;
+
+  // ---- saving results, one row per case ----
+  const Eigen::Index n_cases = static_cast<Eigen::Index>(cases.size());
+  Eigen::VectorXd Xa(n_cases), R1(n_cases), R2(n_cases), pw(n_cases),
+      mu(n_cases), T(n_cases), start_idx(n_cases), n_converged(n_cases);
+  Eigen::MatrixXd x_pos = Eigen::MatrixXd::Constant(
+      n_cases, N + 1, std::numeric_limits<double>::quiet_NaN());
+  Eigen::MatrixXd y_pos = x_pos, x_speed = x_pos, y_speed = x_pos;
+  Eigen::MatrixXd U0 = Eigen::MatrixXd::Constant(
+      n_cases, N, std::numeric_limits<double>::quiet_NaN());
+  Eigen::MatrixXd U1 = U0;
+  for (Eigen::Index i = 0; i < n_cases; ++i) {
+    const race_case &c = cases[i];
+    const case_result &r = results[i];
+    Xa(i) = c.obs.Xa;
+    R1(i) = c.obs.R1;
+    R2(i) = c.obs.R2;
+    pw(i) = c.obs.pow;
+    mu(i) = c.mu;
+    T(i) = r.T;
+    start_idx(i) = r.start;
+    n_converged(i) = r.n_converged;
+    if (r.start < 0)
+      continue;
+    Eigen::Map<const Eigen::MatrixXd> X(r.X.data(), 4, N + 1);
+    Eigen::Map<const Eigen::MatrixXd> U(r.U.data(), 2, N);
+    x_pos.row(i) = X.row(0);
+    y_pos.row(i) = X.row(1);
+    x_speed.row(i) = X.row(2);
+    y_speed.row(i) = X.row(3);
+    U0.row(i) = U.row(0);
+    U1.row(i) = U.row(1);
+  }
+
+  NpzWriter npz("casadi_batch_cpp");
+  npz.write("Nsmp", N);
+  npz.write("Xa", Xa);
+  npz.write("R1", R1);
+  npz.write("R2", R2);
+  npz.write("pow", pw);
+  npz.write("mu", mu);
+  npz.write("T", T);
+  npz.write("start", start_idx);
+  npz.write("n_converged", n_converged);
+  npz.write_matrix("x_pos", x_pos);
+  npz.write_matrix("y_pos", y_pos);
+  npz.write_matrix("x_speed", x_speed);
+  npz.write_matrix("y_speed", y_speed);
+  npz.write_matrix("U0", U0);
+  npz.write_matrix("U1", U1);
+
+  return 0;
+}
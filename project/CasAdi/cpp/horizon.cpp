@@ -0,0 +1,107 @@
+#include <casadi/casadi.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <string>
+#include <vector>
+
+#include "backends.h"          // NLP solver backends
+#include "race_car.h"          // Race-car OCP
+#include "trajectory_writer.h" // Binary trajectory output
+
+using namespace casadi;
+
+/* Timings of one (dynamics, N) run */
+struct horizon_run {
+  double build_ms; // RaceCarOCP: variables, constraints, graph
+  double solve_ms; // opti.solve, including the solver and its derivatives
+  double nlp_ms;   // the NLP solver itself, from its statistics
+  double iter;     // solver iterations
+  double T;        // optimal final time, NaN if the solve failed
+};
+
+static horizon_run run(int N, const std::string &dynamics, const Backend &b) {
+  using ms = std::chrono::duration<double, std::milli>;
+  horizon_run r{};
+  r.nlp_ms = r.iter = std::nan("");
+  auto start = std::chrono::steady_clock::now();
+  RaceCarOCP ocp(N, vehicle{}, constraints{}, dynamics);
+  ocp.opti.solver(b.plugin, b.opts);
+  auto built = std::chrono::steady_clock::now();
+  r.build_ms = ms(built - start).count();
+  try {
+    auto sol = ocp.opti.solve();
+    r.T = static_cast<double>(sol.value(ocp.T));
+  } catch (const std::exception &) {
+    r.T = std::nan("");
+  }
+  r.solve_ms = ms(std::chrono::steady_clock::now() - built).count();
+
+  // statistics of the solve, none if the plugin failed to load
+  try {
+    Dict stats = ocp.opti.stats();
+    if (stats.count("t_wall_total"))
+      r.nlp_ms = 1e3 * stats.at("t_wall_total").as_double();
+    if (stats.count("iter_count"))
+      r.iter = stats.at("iter_count").as_int();
+  } catch (const std::exception &) {
+  }
+  return r;
+}
+
+/*! Main function, usage:
+ *   casadi_horizon [N_max] [N_max_unrolled] [--solver=NAME]
+ *
+ * Construction and solve time of the race-car OCP against the number of
+ * control intervals, with the RK4 steps unrolled into the graph, with one
+ * RK4 Function mapped over the horizon and posed stage by stage. The
+ * unrolled form only runs up to N_max_unrolled (default 1000), its graph
+ * construction grows fastest. --solver picks the backend, see backends.h;
+ * fatrop only solves the stagewise form. */
+int main(int argc, char *argv[]) {
+
+  std::vector<int> sizes; // positional arguments
+  for (int i = 1; i < argc; ++i)
+    if (std::string(argv[i]).rfind("--", 0) != 0)
+      sizes.push_back(std::atoi(argv[i]));
+  int N_max = sizes.size() > 0 ? sizes[0] : 4000;
+  int N_max_unrolled = sizes.size() > 1 ? sizes[1] : 1000;
+  const Backend solver_backend = backend(solver_arg(argc, argv));
+
+  const std::vector<std::string> forms = {"unrolled", "serial", "thread",
+                                          "openmp", "stagewise"};
+  std::vector<double> Ns;
+  for (int N : {40, 100, 250, 500, 1000, 2000, 4000})
+    if (N <= N_max)
+      Ns.push_back(N);
+
+  std::printf("%-9s %6s %10s %10s %10s %5s %8s\n", "dynamics", "N",
+              "build ms", "solve ms", "nlp ms", "iter", "T");
+  NpzWriter npz("casadi_horizon_cpp");
+  npz.write("N", Ns);
+  for (const std::string &form : forms) {
+    std::vector<double> build, solve, nlp, iter, T;
+    for (double N : Ns) {
+      horizon_run r{};
+      r.build_ms = r.solve_ms = r.nlp_ms = r.iter = r.T = std::nan("");
+      if (form != "unrolled" || N <= N_max_unrolled)
+        r = run(static_cast<int>(N), form, solver_backend);
+      std::printf("%-9s %6.0f %10.1f %10.1f %10.1f %5.0f %8.4f\n",
+                  form.c_str(), N, r.build_ms, r.solve_ms, r.nlp_ms, r.iter,
+                  r.T);
+      build.push_back(r.build_ms);
+      solve.push_back(r.solve_ms);
+      nlp.push_back(r.nlp_ms);
+      iter.push_back(r.iter);
+      T.push_back(r.T);
+    }
+    npz.write(form + "_build_ms", build);
+    npz.write(form + "_solve_ms", solve);
+    npz.write(form + "_nlp_ms", nlp);
+    npz.write(form + "_iter", iter);
+    npz.write(form + "_T", T);
+  }
+
+  return 0;
+}
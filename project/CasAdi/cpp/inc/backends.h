@@ -0,0 +1,100 @@
+#ifndef BACKENDS_H
+#define BACKENDS_H
+
+#include <casadi/casadi.hpp>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace casadi;
+
+/* ---------------------------------------------------- */
+/* NLP solver backends */
+/* ---------------------------------------------------- */
+// Backends for the race-car OCP, selected by name:
+//   ipopt       IPOPT with MUMPS, open source, the default
+//   ipopt-ma57  IPOPT with MA57, needs the proprietary HSL library
+//   fatrop      structure-exploiting interior point method, Riccati-based
+//               linear algebra over the multiple-shooting stages; these are
+//               detected from the "stagewise" RaceCarOCP, see race_car.h, so
+//               it needs the symbolic NLP and has no compiled callbacks
+//   sqp-qrqp    CasADi's SQP method with its active-set QP solver qrqp
+//
+// Example:
+//   Backend b = backend(solver_arg(argc, argv));
+//   RaceCarOCP ocp(N, car, cons, b.dynamics);
+//   ocp.opti.solver(b.plugin, b.opts);
+struct Backend {
+  std::string name;     // name as selected
+  std::string plugin;   // nlpsol plugin
+  Dict opts;            // plugin options, quiet
+  bool thread_safe;     // solves may run in several threads at once
+  std::string dynamics; // RaceCarOCP form the solver needs
+  bool codegen;         // runs on compiled callbacks, see nlp_cache.h
+};
+
+/* Names of all backends, in the order of the table above */
+inline const std::vector<std::string> &backend_names() {
+  static const std::vector<std::string> names = {"ipopt", "ipopt-ma57",
+                                                 "fatrop", "sqp-qrqp"};
+  return names;
+}
+
+/* Backend by name, throws std::invalid_argument for unknown names */
+inline Backend backend(const std::string &name) {
+  Backend b{name, "", {}, true, "serial", true};
+  if (name == "ipopt" || name == "ipopt-ma57") {
+    b.plugin = "ipopt";
+    b.opts["ipopt.print_level"] = 0;
+    b.opts["ipopt.sb"] = "yes";
+    b.opts["ipopt.linear_solver"] = name == "ipopt" ? "mumps" : "ma57";
+    b.thread_safe = name != "ipopt"; // MUMPS keeps global state
+  } else if (name == "fatrop") {
+    b.plugin = "fatrop";
+    b.dynamics = "stagewise"; // per-stage gaps, no variable shared by stages
+    b.codegen = false;        // structure detection and expand need the graph
+    b.opts["structure_detection"] = "auto";
+    b.opts["expand"] = true;
+    b.opts["fatrop.print_level"] = 0;
+    b.opts["fatrop.mu_init"] = 0.1;
+  } else if (name == "sqp-qrqp") {
+    b.plugin = "sqpmethod";
+    b.opts["qpsol"] = "qrqp";
+    b.opts["qpsol_options"] = Dict{{"print_iter", false},
+                                   {"print_header", false},
+                                   {"error_on_fail", false}};
+    b.opts["print_header"] = false;
+    b.opts["print_iteration"] = false;
+    b.opts["print_status"] = false;
+    b.opts["max_iter"] = 200;
+  } else {
+    throw std::invalid_argument("unknown solver backend " + name +
+                                ", use ipopt, ipopt-ma57, fatrop or "
+                                "sqp-qrqp");
+  }
+  b.opts["print_time"] = false;
+  return b;
+}
+
+/* Throws std::invalid_argument if the backend cannot run on compiled
+ * callbacks, for the --codegen flag */
+inline void check_codegen(const Backend &b) {
+  if (!b.codegen)
+    throw std::invalid_argument("--codegen is not supported by " + b.name +
+                                ", it needs the symbolic NLP");
+}
+
+/* Backend name from a --solver=NAME argument, fallback without one */
+inline std::string solver_arg(int argc, char *argv[],
+                              const std::string &fallback = "ipopt") {
+  const std::string flag = "--solver=";
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg.rfind(flag, 0) == 0)
+      return arg.substr(flag.size());
+  }
+  return fallback;
+}
+/* ---------------------------------------------------- */
+
+#endif // BACKENDS_H
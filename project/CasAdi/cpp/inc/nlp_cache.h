@@ -0,0 +1,104 @@
+#ifndef NLP_CACHE_H
+#define NLP_CACHE_H
+
+#include <casadi/casadi.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace casadi;
+
+/* ---------------------------------------------------- */
+/* Code-generated NLP callbacks, compiled once and cached */
+/* ---------------------------------------------------- */
+// The objective, constraints, their derivatives and the Hessian of the
+// Lagrangian are generated as C code, compiled to a shared object and loaded
+// by the solver, which then skips CasADi's virtual machine on every callback.
+// The shared object is named by a hash of the problem structure, (x, p) ->
+// (f, g), the plugin and the compile command, so later runs of the same
+// problem only load it. A changed problem gets a new hash and is rebuilt.
+//
+// Example:
+//   MXDict nlp = {{"x", x}, {"p", p}, {"f", f}, {"g", g}};
+//   Function solver = cached_nlpsol("race_car", "ipopt", nlp, opts);
+//   auto res = solver(DMDict{{"x0", x0}, {"p", p0}, ...});
+struct NlpCacheOptions {
+  std::string dir = "nlp_cache";                 // cache directory
+  std::string compile = "gcc -fPIC -shared -O2"; // compile command
+  bool verbose = true;                           // report builds and hits
+};
+
+/* 64-bit FNV-1a, stable across runs and compilers */
+inline uint64_t fnv1a(const std::string &data) {
+  uint64_t h = 0xcbf29ce484222325ull;
+  for (unsigned char c : data) {
+    h ^= c;
+    h *= 0x100000001b3ull;
+  }
+  return h;
+}
+
+/* Path of the cached shared object for an NLP */
+inline std::filesystem::path nlp_cache_path(const std::string &name,
+                                            const std::string &plugin,
+                                            const MXDict &nlp,
+                                            const NlpCacheOptions &cache) {
+  Function structure("nlp", {nlp.at("x"), nlp.at("p")},
+                     {nlp.at("f"), nlp.at("g")});
+  char hex[17];
+  std::snprintf(hex, sizeof(hex), "%016llx",
+                static_cast<unsigned long long>(fnv1a(
+                    structure.serialize() + '\n' + plugin + '\n' +
+                    cache.compile)));
+  return std::filesystem::path(cache.dir) / (name + "_" + hex + ".so");
+}
+
+/* nlpsol(name, plugin, nlp, opts) with compiled callbacks, built on the
+ * first call for this problem and loaded from the cache afterwards. Options
+ * that work on the symbolic NLP, expand and structure_detection, have
+ * nothing to act on in a loaded shared object and throw
+ * std::invalid_argument */
+inline Function cached_nlpsol(const std::string &name,
+                              const std::string &plugin, const MXDict &nlp,
+                              const Dict &opts,
+                              const NlpCacheOptions &cache = {}) {
+  namespace fs = std::filesystem;
+  for (const char *symbolic : {"expand", "structure_detection"})
+    if (opts.count(symbolic))
+      throw std::invalid_argument(std::string("cached_nlpsol: option ") +
+                                  symbolic + " needs the symbolic NLP");
+  const fs::path so = nlp_cache_path(name, plugin, nlp, cache);
+  if (fs::exists(so)) {
+    if (cache.verbose)
+      std::cout << "loading cached NLP " << so.string() << std::endl;
+    return nlpsol(name, plugin, so.string(), opts);
+  }
+
+  // generate next to the working directory, then move into the cache
+  fs::create_directories(cache.dir);
+  const std::string c_file = so.stem().string() + ".c";
+  Function solver = nlpsol(name, plugin, nlp, opts);
+  solver.generate_dependencies(c_file);
+  const fs::path c_path = fs::path(cache.dir) / c_file;
+  fs::rename(c_file, c_path);
+
+  // compile to a temporary name and rename, so an interrupted build never
+  // leaves a broken object behind for the next run
+  const fs::path tmp = so.string() + ".tmp";
+  const std::string cmd =
+      cache.compile + " " + c_path.string() + " -o " + tmp.string();
+  if (cache.verbose)
+    std::cout << "compiling NLP: " << cmd << std::endl;
+  if (std::system(cmd.c_str()) != 0)
+    throw std::runtime_error("cached_nlpsol: compile failed: " + cmd);
+  fs::rename(tmp, so);
+
+  return nlpsol(name, plugin, so.string(), opts);
+}
+/* ---------------------------------------------------- */
+
+#endif // NLP_CACHE_H
@@ -0,0 +1,360 @@
+#ifndef RACE_CAR_H
+#define RACE_CAR_H
+
+#include <algorithm>
+#include <casadi/casadi.hpp>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "nlp_cache.h" // Compiled NLP callbacks
+
+using namespace casadi;
+
+/* ---------------------------------------------------- */
+// define model struct
+struct vehicle {
+  double Xfin = 50;  // final position
+  double mass = 500; // mass of the car
+  double mu = 0.8;   // friction coefficient
+  double g = 9.81;   // gravity
+};
+
+// constraints
+struct constraints {
+  double Ymax = 5;              // y direction upper bound
+  double delta_max = M_PI / 2;  // steering angle upper bound
+  double ddelta_max = M_PI / 6; // steering rate upper bound
+  double vx_init = 40 / 3.6;    // initial velocity
+  double y_init = 1;            // initial (and final) lane
+};
+
+// obstacle struct
+struct obstacle {
+  double Xa = 50; // obstacle position
+  double R1 = 4;  // obstacle radius
+  double R2 = 2;  // obstacle radius
+  double pow = 6; // sharpness of the obstacle
+};
+
+// initial guess for the solver
+struct initial_guess {
+  double ypos = 1;  // lateral position, constant along the track
+  double T = 1;     // final time
+  double U0 = 1000; // longitudinal force
+};
+/* ---------------------------------------------------- */
+
+// dx/dt = f(x,u)
+inline MX f(const MX &x, const MX &u, const vehicle &car) {
+  return vertcat(x(2), x(3), u(0) / car.mass, u(1) / car.mass);
+}
+
+// one RK4 step of f over h, in n_sub sub-steps, (x, u, h) -> x(t + h)
+inline Function rk4_step(const vehicle &car, int n_sub = 1) {
+  MX x = MX::sym("x", 4), u = MX::sym("u", 2), h = MX::sym("h");
+  MX dt = h / n_sub;
+  MX xk = x;
+  for (int i = 0; i < n_sub; ++i) {
+    auto k1 = f(xk, u, car);
+    auto k2 = f(xk + dt / 2 * k1, u, car);
+    auto k3 = f(xk + dt / 2 * k2, u, car);
+    auto k4 = f(xk + dt * k3, u, car);
+    xk = xk + dt / 6 * (k1 + 2 * k2 + 2 * k3 + k4);
+  }
+  return Function("rk4", {x, u, h}, {xk});
+}
+
+// obstacle function, the exponent is a parameter, so constpow keeps its
+// derivative out of the NLP callbacks (log of a negative base)
+inline MX obst_elipse(const MX &x, const MX &y, const MX &Xa, const MX &R1,
+                      const MX &R2, const MX &p) {
+  return 1 - constpow((x - Xa) / R1, p) - constpow(y / R2, p);
+}
+
+/* ---------------------------------------------------- */
+/* Race-car OCP, direct multiple shooting */
+/* ---------------------------------------------------- */
+// Car race along a track past an elliptic obstacle. The obstacle geometry
+// (Xa, R1, R2, pow), the friction coefficient mu and the initial state
+// x_init are Opti parameters, so the NLP is built once and solved for any
+// case by set_case / set_state, or through to_function /
+// to_compiled_function for batches. For more information see:
+// http://labs.casadi.org/OCP
+//
+// dynamics selects how the shooting gaps are posed:
+//   "unrolled"                   RK4 expanded symbolically on every interval,
+//                                the graph grows with N
+//   "serial", "thread", "openmp" one RK4 Function applied to all intervals
+//                                with map(N, dynamics), one vectorized call;
+//                                "thread" uses at most one thread per core
+//   "stagewise"                  variables and constraints declared stage by
+//                                stage, with T carried as a per-stage state,
+//                                T(k + 1) == T(k); the form fatrop's
+//                                structure detection needs, see backends.h
+//
+// Example:
+//   RaceCarOCP ocp;
+//   ocp.set_case(obstacle{}, 0.8);
+//   ocp.set_initial(initial_guess{});
+//   auto sol = ocp.opti.solve();
+class RaceCarOCP {
+public:
+  explicit RaceCarOCP(int N = 40, const vehicle &car = {},
+                      const constraints &cons = {},
+                      const std::string &dynamics = "serial")
+      : N(N), car(car), cons(cons), dynamics(dynamics) {
+    Slice all;
+    // ---- decision variables ---------
+    std::vector<MX> xs, us, Ts; // per stage, "stagewise" only
+    if (dynamics == "stagewise") {
+      // states of stage k (x, T), then its controls u
+      for (int k = 0; k <= N; ++k) {
+        xs.push_back(opti.variable(4));
+        Ts.push_back(opti.variable());
+        if (k < N)
+          us.push_back(opti.variable(2));
+      }
+      X = horzcat(xs);
+      U = horzcat(us);
+      T = Ts[0];
+      T_stages = horzcat(Ts);
+    } else {
+      X = opti.variable(4, N + 1); // state trajectory
+      U = opti.variable(2, N);     // control trajectory (force)
+      T = opti.variable();         // final time
+      T_stages = T;
+    }
+    xpos = X(0, all);
+    ypos = X(1, all);
+    xspeed = X(2, all);
+    yspeed = X(3, all);
+
+    // ---- parameters -----------------
+    Xa = opti.parameter();      // obstacle position
+    R1 = opti.parameter();      // obstacle radius in x
+    R2 = opti.parameter();      // obstacle radius in y
+    pow = opti.parameter();     // sharpness of the obstacle
+    mu = opti.parameter();      // friction coefficient
+    x_init = opti.parameter(4); // initial state
+
+    // ---- objective          ---------
+    opti.minimize(T); // race in minimal time
+
+    if (dynamics == "stagewise")
+      pose_stages(xs, us, Ts);
+    else
+      pose_matrices();
+
+    set_case(obstacle{}, car.mu);
+    set_state(start_state());
+    set_initial(initial_guess{});
+  }
+
+  /* State at the start line: position 0 on lane y_init at vx_init */
+  DM start_state() const {
+    return DM(std::vector<double>{0.0, cons.y_init, cons.vx_init, 0.0});
+  }
+
+  /* Initial state for the next solve, the measured state in MPC */
+  void set_state(const DM &x) { opti.set_value(x_init, x); }
+
+  /* Parameter values for the next solve */
+  void set_case(const obstacle &obs, double mu_value) {
+    opti.set_value(Xa, obs.Xa);
+    opti.set_value(R1, obs.R1);
+    opti.set_value(R2, obs.R2);
+    opti.set_value(pow, obs.pow);
+    opti.set_value(mu, mu_value);
+  }
+
+  /* Initial guess for the next solve */
+  void set_initial(const initial_guess &guess) {
+    Slice all;
+    opti.set_initial(xpos, 0);
+    opti.set_initial(ypos, guess.ypos);
+    opti.set_initial(xspeed, cons.vx_init);
+    opti.set_initial(yspeed, 0);
+    opti.set_initial(T_stages, guess.T);
+    opti.set_initial(U(0, all), guess.U0);
+    opti.set_initial(U(1, all), 0);
+  }
+
+  /* The NLP as one function of the parameters and the initial guess, call
+   * it from any thread once opti.solver(...) is set:
+   *   (Xa, R1, R2, pow, mu, x_init, X0, U0, T0) -> (T, X, U)
+   * X0, U0 and T0 are the initial guesses for X, U and T_stages. */
+  Function to_function(const std::string &name) {
+    return opti.to_function(
+        name, {Xa, R1, R2, pow, mu, x_init, X, U, T_stages}, {T, X, U},
+        {"Xa", "R1", "R2", "pow", "mu", "x_init", "X0", "U0", "T0"},
+        {"T", "X", "U"});
+  }
+
+  /* Same signature as to_function, but IPOPT (or any plugin) runs on
+   * compiled callbacks, see nlp_cache.h. The bounds of g depend on mu and
+   * are evaluated from the parameters on every call. */
+  Function to_compiled_function(const std::string &name,
+                                const std::string &plugin, const Dict &opts,
+                                const NlpCacheOptions &cache = {}) {
+    MX x = opti.x(), p = opti.p();
+    Function solver = cached_nlpsol(
+        name + "_nlp", plugin,
+        {{"x", x}, {"p", p}, {"f", opti.f()}, {"g", opti.g()}}, opts, cache);
+    Function bounds("bounds", {p}, {opti.lbg(), opti.ubg()});
+    Function pack_p("pack_p", {Xa, R1, R2, pow, mu, x_init}, {p});
+    Function pack_x("pack_x", {X, U, T_stages}, {x});
+    Function unpack_x("unpack_x", {x}, {X, U, T});
+
+    MX Xa_in = MX::sym("Xa"), R1_in = MX::sym("R1"), R2_in = MX::sym("R2"),
+       pow_in = MX::sym("pow"), mu_in = MX::sym("mu");
+    MX x_init_in = MX::sym("x_init", 4);
+    MX X0 = MX::sym("X0", X.size1(), X.size2());
+    MX U0 = MX::sym("U0", U.size1(), U.size2());
+    MX T0 = MX::sym("T0", T_stages.size1(), T_stages.size2());
+    MX p_in = pack_p(std::vector<MX>{Xa_in, R1_in, R2_in, pow_in, mu_in,
+                                     x_init_in})[0];
+    std::vector<MX> lu = bounds(std::vector<MX>{p_in});
+    MXDict res = solver(
+        MXDict{{"x0", pack_x(std::vector<MX>{X0, U0, T0})[0]},
+               {"p", p_in},
+               {"lbg", lu[0]},
+               {"ubg", lu[1]}});
+    std::vector<MX> xut = unpack_x(std::vector<MX>{res.at("x")});
+    return Function(
+        name, {Xa_in, R1_in, R2_in, pow_in, mu_in, x_init_in, X0, U0, T0},
+        {xut[2], xut[0], xut[1]},
+        {"Xa", "R1", "R2", "pow", "mu", "x_init", "X0", "U0", "T0"},
+        {"T", "X", "U"});
+  }
+
+  /* Arguments of to_function's function for one case and initial guess */
+  DMDict arguments(const obstacle &obs, double mu_value,
+                   const initial_guess &guess) const {
+    DM X0 = DM::zeros(4, N + 1);
+    X0(1, Slice()) = guess.ypos;
+    X0(2, Slice()) = cons.vx_init;
+    DM U0 = DM::zeros(2, N);
+    U0(0, Slice()) = guess.U0;
+    return {{"Xa", obs.Xa},   {"R1", obs.R1},
+            {"R2", obs.R2},   {"pow", obs.pow},
+            {"mu", mu_value}, {"x_init", start_state()},
+            {"X0", X0},       {"U0", U0},
+            {"T0", DM::repmat(guess.T, 1, T_stages.size2())}};
+  }
+
+private:
+  // constraints on whole trajectories, one column per node or interval
+  void pose_matrices() {
+    Slice all;
+    // ---- dynamic constraints --------
+    auto dt = T / N;
+    MX x_next; // RK4 from every node but the last, 4 x N
+    if (dynamics == "unrolled") {
+      std::vector<MX> steps;
+      for (int k = 0; k < N; ++k) {
+        auto k1 = f(X(all, k), U(all, k), car);
+        auto k2 = f(X(all, k) + dt / 2 * k1, U(all, k), car);
+        auto k3 = f(X(all, k) + dt / 2 * k2, U(all, k), car);
+        auto k4 = f(X(all, k) + dt * k3, U(all, k), car);
+        steps.push_back(X(all, k) + dt / 6 * (k1 + 2 * k2 + 2 * k3 + k4));
+      }
+      x_next = horzcat(steps);
+    } else if (dynamics == "serial" || dynamics == "thread" ||
+               dynamics == "openmp") {
+      // a thread map would otherwise start one thread per interval
+      Dict map_opts;
+      if (dynamics == "thread")
+        map_opts["max_num_threads"] = static_cast<casadi_int>(
+            std::max(1u, std::thread::hardware_concurrency()));
+      const std::vector<casadi_int> no_reduce; // typed, {} is ambiguous
+      Function F = rk4_step(car).map("F", dynamics, N, no_reduce, no_reduce,
+                                     map_opts); // dt is broadcast
+      x_next = F(std::vector<MX>{X(all, Slice(0, N)), U, dt})[0];
+    } else {
+      throw std::invalid_argument("RaceCarOCP: unknown dynamics " +
+                                  dynamics);
+    }
+    MX gaps = X(all, Slice(1, N + 1)) == x_next;
+    opti.subject_to(gaps); // close the gaps
+
+    // ---- input constraints -----------
+    auto Flim =
+        U(0, all) * U(0, all) + U(1, all) * U(1, all); // control force limit
+    auto Fmax = car.mass * mu * car.g;                 // friction limit
+    MX force = 0 <= Flim <= Fmax * Fmax;
+    opti.subject_to(force); // control force limit
+
+    // ---- path constraints -----------
+    MX obst = obst_elipse(xpos, ypos, Xa, R1, R2, pow) <= 0;
+    opti.subject_to(obst); // obstacle
+
+    // ---- speed and position constraints -----------
+    MX speed = xspeed > 0, track = 0 <= ypos < cons.Ymax;
+    opti.subject_to(speed); // speed is positive
+    opti.subject_to(track); // track limits
+
+    interval_constraints = {gaps, force};
+    node_constraints = {obst, speed, track};
+
+    // ---- boundary conditions --------
+    opti.subject_to(X(all, 0) == x_init); // start state, see start_state
+
+    opti.subject_to(xpos(N) == 2 * car.Xfin); // finish line
+    opti.subject_to(ypos(N) == cons.y_init);  // back on the start lane
+
+    // ---- misc. constraints  ----------
+    opti.subject_to(T >= 0); // Time must be positive
+  }
+
+  // constraints stage by stage: the start state, then per stage its path
+  // constraints and its gap, x(k + 1) == F(x(k), u(k), T(k) / N) and
+  // T(k + 1) == T(k), and the finish line at the last stage
+  void pose_stages(const std::vector<MX> &xs, const std::vector<MX> &us,
+                   const std::vector<MX> &Ts) {
+    Function F = rk4_step(car);
+    auto Fmax = car.mass * mu * car.g; // friction limit
+    opti.subject_to(xs[0] == x_init);  // start state, see start_state
+    opti.subject_to(Ts[0] >= 0);       // Time must be positive
+    for (int k = 0; k <= N; ++k) {
+      const MX &x = xs[k];
+      opti.subject_to(obst_elipse(x(0), x(1), Xa, R1, R2, pow) <= 0);
+      opti.subject_to(x(2) > 0);              // speed is positive
+      opti.subject_to(0 <= x(1) < cons.Ymax); // track limits
+      if (k == N)
+        break;
+      const MX &u = us[k];
+      opti.subject_to(0 <= u(0) * u(0) + u(1) * u(1) <= Fmax * Fmax);
+      MX x_next = F(std::vector<MX>{x, u, Ts[k] / N})[0];
+      opti.subject_to(vertcat(xs[k + 1], Ts[k + 1]) ==
+                      vertcat(x_next, Ts[k])); // close the gaps
+    }
+    opti.subject_to(xs[N](0) == 2 * car.Xfin); // finish line
+    opti.subject_to(xs[N](1) == cons.y_init);  // back on the start lane
+  }
+
+public:
+  int N; // number of control intervals
+  vehicle car;
+  constraints cons;
+  std::string dynamics; // shooting gaps, unrolled, mapped or stagewise
+
+  Opti opti;                        // optimization problem
+  MX X, xpos, ypos, xspeed, yspeed; // state trajectory and its rows
+  MX U;                             // control trajectory
+  MX T;                             // final time
+  MX T_stages;                      // T, or its stage copies, 1 x (N + 1)
+  MX Xa, R1, R2, pow, mu;           // case parameters
+  MX x_init;                        // initial state
+
+  // constraints with one column per interval (N) or per node (N + 1), e.g.
+  // to shift their multipliers, opti.dual(c), along with the trajectories;
+  // empty in the "stagewise" form
+  std::vector<MX> interval_constraints; // shooting gaps, force limit
+  std::vector<MX> node_constraints;     // obstacle, speed, track limits
+};
+/* ---------------------------------------------------- */
+
+#endif // RACE_CAR_H
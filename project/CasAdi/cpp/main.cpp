@@ -22,68 +22,40 @@
  */
 
 #include <casadi/casadi.hpp>
+#include <chrono>
 #include <ctime>
-#include <fstream>
 #include <iostream>
-#include <nlohmann/json.hpp>
 #include <vector>
 
-using namespace casadi;
-using nljson = nlohmann::json;
-
-/* ---------------------------------------------------- */
-/* Function to reate a json file */
-/* ---------------------------------------------------- */
-void create_jsonfile(std::string filename, const nljson &json_obj) {
+#include "backends.h"          // NLP solver backends
+#include "json_writer.h"       // Streaming JSON output
+#include "race_car.h"          // Race-car OCP
+#include "trajectory_writer.h" // Binary trajectory output
 
-  filename += ".json"; // Append .json to filename
-
-  std::ofstream file(filename);
-  if (file.is_open()) {
-    file << json_obj.dump(4); // Pretty print with 4 spaces
-    file.close();
-    std::cout << "saved to " << filename << std::endl;
-  } else {
-    std::cerr << "Unable to open file for writing" << std::endl;
-  }
-}
+using namespace casadi;
 
-/* ---------------------------------------------------- */
-// define model struct
-struct vehicle {
-  double Xfin = 50;  // final position
-  double mass = 500; // mass of the car
-  double mu = 0.8;   // friction coefficient
-  double g = 9.81;   // gravity
-};
-
-// constraints
-struct constraints {
-  double Ymax = 5;              // y direction upper bound
-  double delta_max = M_PI / 2;  // steering angle upper bound
-  double ddelta_max = M_PI / 6; // steering rate upper bound
-  double vx_init = 40 / 3.6;    // initial velocity
-};
-
-// obstacle struct
-struct obstacle {
-  double Xa = 50; // obstacle position
-  double R1 = 4;  // obstacle radius
-  double R2 = 2;  // obstacle radius
-  double pow = 6; // sharpness of the obstacle
-};
-
-// dx/dt = f(x,u)
-MX f(const MX &x, const MX &u, const vehicle &car) {
-  return vertcat(x(2), x(3), u(0) / car.mass, u(1) / car.mass);
+/* Print the setup (problem, solver) and solve times since start */
+static void report_time(std::chrono::steady_clock::time_point start,
+                        std::chrono::steady_clock::time_point ready) {
+  using ms = std::chrono::duration<double, std::milli>;
+  auto done = std::chrono::steady_clock::now();
+  std::cout << "setup " << ms(ready - start).count() << " ms, solve "
+            << ms(done - ready).count() << " ms" << std::endl;
 }
 
-// obstacle function
-MX obst_elipse(const MX &x, const MX &y, const obstacle &obs) {
-  return 1 - pow((x - obs.Xa) / obs.R1, obs.pow) - pow(y / obs.R2, obs.pow);
-}
+int main(int argc, char *argv[]) {
 
-int main() {
+  // binary .npz output by default, JSON on request; --codegen runs the
+  // solver on compiled callbacks, cached in nlp_cache/ for the next run;
+  // --solver=NAME picks the backend, IPOPT with MUMPS by default
+  const Backend solver_backend = backend(solver_arg(argc, argv));
+  bool save_json = false, codegen = false;
+  for (int i = 1; i < argc; ++i) {
+    save_json |= std::string(argv[i]) == "--json";
+    codegen |= std::string(argv[i]) == "--codegen";
+  }
+  if (codegen)
+    check_codegen(solver_backend);
 
   // Car race along a track
   // ----------------------
@@ -94,102 +66,85 @@ int main() {
 
   vehicle car;
   obstacle obst;
-  constraints cons;
 
   int N = 40; // number of control intervals
 
-  auto opti = casadi::Opti(); // Optimization problem
+  auto start = std::chrono::steady_clock::now();
+  RaceCarOCP ocp(N, car, constraints{},
+                 solver_backend.dynamics); // Optimization problem
+  auto &opti = ocp.opti;
 
   Slice all;
-  // ---- decision variables ---------
-  auto X = opti.variable(4, N + 1); // state trajectory
-  auto xpos = X(0, all);
-  auto ypos = X(1, all);
-  auto xspeed = X(2, all);
-  auto yspeed = X(3, all);
-  auto U = opti.variable(2, N); //% control trajectory(throttle)
-  auto T = opti.variable();     // final time
-
-  // ---- objective          ---------
-  opti.minimize(T); // race in minimal time
-
-  // ---- dynamic constraints --------
-  auto dt = T / N;
-  for (int k = 0; k < N; ++k) {
-    auto k1 = f(X(all, k), U(all, k), car);
-    auto k2 = f(X(all, k) + dt / 2 * k1, U(all, k), car);
-    auto k3 = f(X(all, k) + dt / 2 * k2, U(all, k), car);
-    auto k4 = f(X(all, k) + dt * k3, U(all, k), car);
-    auto x_next = X(all, k) + dt / 6 * (k1 + 2 * k2 + 2 * k3 + k4);
-    opti.subject_to(X(all, k + 1) == x_next); // close the gaps
-  }
 
-  // ---- input constraints -----------
-  auto Flim =
-      U(0, all) * U(0, all) + U(1, all) * U(1, all); // control force limit
-  opti.subject_to(0 <= Flim <=
-                  pow(car.mass * car.mu * car.g, 2)); // control force limit
-
-  // ---- path constraints -----------
-  opti.subject_to(obst_elipse(xpos, ypos, obst) <= 0); // obstacle
-
-  // ---- spped and position constraints -----------
-  opti.subject_to(xspeed > 0);            // speed is positive
-  opti.subject_to(0 <= ypos < cons.Ymax); // track limits
-
-  // ---- boundary conditions --------
-  opti.subject_to(xpos(0) == 0);              // start at position 0 ...
-  opti.subject_to(ypos(0) == 1);              // start at position 1 ...
-  opti.subject_to(xspeed(0) == cons.vx_init); // start at speed 40/3.6 ...
-  opti.subject_to(yspeed(0) == 0);            // ... from stand-still
-
-  opti.subject_to(xpos(N) == 2 * car.Xfin); // finish line at position 1
-  opti.subject_to(ypos(N) == ypos(0));      // finish line at position 1
-
-  // ---- misc. constraints  ----------
-  opti.subject_to(T >= 0); // Time must be positive
-
-  // ---- initial values for solver ---
-  opti.set_initial(xpos, 0);
-  opti.set_initial(ypos, 1);
-  opti.set_initial(xspeed, cons.vx_init);
-  opti.set_initial(yspeed, 0);
-  opti.set_initial(T, 1);
-  opti.set_initial(U(0, all), 1000);
-  opti.set_initial(U(1, all), 0);
-
-  Dict opts;
-  opts["ipopt.print_level"] = 0;
+  // ---- case and initial values for solver ---
+  ocp.set_case(obst, car.mu);
+  ocp.set_initial(initial_guess{});
+
+  Dict opts = solver_backend.opts;
   // opts["ipopt.tol"] = 1e-8;
-  opts["ipopt.linear_solver"] = "ma57";
-  opti.solver("ipopt", opts); // set numerical backend
-  // opti.solver("ipopt");    // set numerical backend
-  auto sol = opti.solve(); // actual solve
+  opts["error_on_fail"] = true;
+
+  DM T_sol, X_sol, U_sol;
+  if (codegen) {
+    Function solver =
+        ocp.to_compiled_function("race_car", solver_backend.plugin, opts);
+    auto ready = std::chrono::steady_clock::now();
+    DMDict res = solver(ocp.arguments(obst, car.mu, initial_guess{}));
+    report_time(start, ready);
+    T_sol = res.at("T");
+    X_sol = res.at("X");
+    U_sol = res.at("U");
+  } else {
+    opti.solver(solver_backend.plugin, opts); // set numerical backend
+    // opti.solver("ipopt");    // set numerical backend
+    auto ready = std::chrono::steady_clock::now();
+    auto sol = opti.solve(); // actual solve
+    report_time(start, ready);
+    T_sol = sol.value(ocp.T);
+    X_sol = sol.value(ocp.X);
+    U_sol = sol.value(ocp.U);
+  }
 
   // ---- post-processing          ----
-  double Tend = (double)sol.value(T);
+  double Tend = static_cast<double>(T_sol);
   int Nsmp = N;
 
-  std::vector<double> x_pos = std::vector<double>(sol.value(xpos));
-  std::vector<double> y_pos = std::vector<double>(sol.value(ypos));
-  std::vector<double> x_speed = std::vector<double>(sol.value(xspeed));
-  std::vector<double> y_speed = std::vector<double>(sol.value(yspeed));
-
-  std::vector<double> U0 = std::vector<double>(sol.value(U(0, all)));
-  std::vector<double> U1 = std::vector<double>(sol.value(U(1, all)));
-
-  // ---- saving results to json file ----
-  nljson json_obj;
-  json_obj["T"] = Tend;
-  json_obj["Nsmp"] = Nsmp;
-  json_obj["x_pos"] = x_pos;
-  json_obj["y_pos"] = y_pos;
-  json_obj["x_speed"] = x_speed;
-  json_obj["y_speed"] = y_speed;
-  json_obj["U0"] = U0;
-  json_obj["U1"] = U1;
-
-  create_jsonfile("casadi_cpp_sim", json_obj);
+  auto row = [&](const DM &M, int i) {
+    DM r = M(i, all);
+    return std::vector<double>(r);
+  };
+  std::vector<double> x_pos = row(X_sol, 0);
+  std::vector<double> y_pos = row(X_sol, 1);
+  std::vector<double> x_speed = row(X_sol, 2);
+  std::vector<double> y_speed = row(X_sol, 3);
+
+  std::vector<double> U0 = row(U_sol, 0);
+  std::vector<double> U1 = row(U_sol, 1);
+
+  // ---- saving results to npz or json file ----
+  if (save_json) {
+    JsonWriter json("casadi_cpp_sim");
+    json.begin_object();
+    json.field("T", Tend);
+    json.field("Nsmp", Nsmp);
+    json.field("x_pos", x_pos);
+    json.field("y_pos", y_pos);
+    json.field("x_speed", x_speed);
+    json.field("y_speed", y_speed);
+    json.field("U0", U0);
+    json.field("U1", U1);
+    json.end_object();
+  } else {
+    NpzWriter npz("casadi_cpp_sim");
+    npz.write("T", Tend);
+    npz.write("Nsmp", Nsmp);
+    npz.write("x_pos", x_pos);
+    npz.write("y_pos", y_pos);
+    npz.write("x_speed", x_speed);
+    npz.write("y_speed", y_speed);
+    npz.write("U0", U0);
+    npz.write("U1", U1);
+  }
 
   // // Create Matlab script to plot the solution
   // std::ofstream file;
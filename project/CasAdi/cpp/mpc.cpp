@@ -0,0 +1,197 @@
+#include <algorithm>
+#include <casadi/casadi.hpp>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "backends.h"          // NLP solver backends
+#include "race_car.h"          // Race-car OCP
+#include "trajectory_writer.h" // Binary trajectory output
+
+using namespace casadi;
+
+/* Value at the q-quantile (nearest rank) of v */
+static double percentile(std::vector<double> v, double q) {
+  if (v.empty())
+    return std::nan("");
+  std::sort(v.begin(), v.end());
+  size_t rank = static_cast<size_t>(std::ceil(q * v.size()));
+  return v[std::clamp<size_t>(rank, 1, v.size()) - 1];
+}
+
+/*! Main function, usage: casadi_mpc [--cold] [--solver=NAME]
+ *
+ * Shrinking-horizon MPC on the race-car problem. Every sample period Ts the
+ * OCP is re-solved from the measured state over the remaining race, the
+ * plan is applied for Ts, and the horizon (N intervals over the remaining
+ * time T) shrinks with it. Ts is fixed by the first, cold solve as T / N.
+ *
+ * Re-solves start from the previous primal and dual solution, shifted by
+ * one sample, with IPOPT's warm-start options. --cold restarts every solve
+ * from the constant initial guess instead, for comparison. --solver picks
+ * the backend, see backends.h; the warm-start options only apply to IPOPT.
+ * The saved run has one sample per applied plan interval, U0 and U1 hold the
+ * control held from t[i] to t[i + 1]. */
+int main(int argc, char *argv[]) {
+
+  bool warm = true;
+  for (int i = 1; i < argc; ++i)
+    warm &= std::string(argv[i]) != "--cold";
+  const Backend solver_backend = backend(solver_arg(argc, argv));
+
+  vehicle car;
+  obstacle obst;
+  int N = 40; // number of control intervals
+
+  RaceCarOCP ocp(N, car, constraints{}, solver_backend.dynamics);
+  auto &opti = ocp.opti;
+  ocp.set_case(obst, car.mu);
+  Function plant = rk4_step(car, 10); // plant, RK4 in 10 sub-steps
+
+  Dict opts = solver_backend.opts;
+
+  // ---- first solve from the start line, cold ----
+  opti.solver(solver_backend.plugin, opts);
+  auto sol = opti.solve();
+  const double Ts = static_cast<double>(sol.value(ocp.T)) / N; // sample
+
+  // re-solves: keep the warm start close to the bounds and begin with a
+  // small barrier parameter, the shifted solution is already near-optimal
+  if (warm) {
+    if (solver_backend.plugin == "ipopt") {
+      opts["ipopt.warm_start_init_point"] = "yes";
+      opts["ipopt.warm_start_bound_push"] = 1e-9;
+      opts["ipopt.warm_start_bound_frac"] = 1e-9;
+      opts["ipopt.warm_start_mult_bound_push"] = 1e-9;
+      opts["ipopt.mu_init"] = 1e-6;
+    }
+    opti.solver(solver_backend.plugin, opts);
+
+    // build the warm-start solver outside the timed loop, re-solving the
+    // first problem from its own solution
+    opti.set_initial(sol.value_variables());
+    opti.set_initial(opti.lam_g(), sol.value(opti.lam_g()));
+    sol = opti.solve();
+  }
+
+  // ---- closed loop ----
+  DM x = ocp.start_state(); // measured state
+  double t = 0.0;
+  std::vector<double> ts{t}, xs(x.nonzeros()), us;
+  std::vector<double> latency_ms, iterations;
+  using ms = std::chrono::duration<double, std::milli>;
+  for (int k = 0; k < 2 * N; ++k) { // N samples nominally, 2 N at most
+    const double T = static_cast<double>(sol.value(ocp.T));
+    const std::vector<double> U(sol.value(ocp.U));
+    const double h = T / N; // interval of the current plan
+
+    // apply the plan for one sample, interval by interval; every applied
+    // (dt, u) segment is recorded, a sample spans several when h < Ts
+    const double step = std::min(Ts, T);
+    for (int j = 0; j * h < step * (1 - 1e-9); ++j) {
+      double dt = std::min((j + 1) * h, step) - j * h;
+      us.insert(us.end(), U.begin() + 2 * j, U.begin() + 2 * j + 2);
+      DM u = DM(std::vector<double>{U[2 * j], U[2 * j + 1]});
+      x = plant(std::vector<DM>{x, u, dt})[0];
+      t += dt;
+      ts.push_back(t);
+      const std::vector<double> x_now(x);
+      xs.insert(xs.end(), x_now.begin(), x_now.end());
+    }
+    if (T <= Ts * (1 + 1e-9))
+      break; // crossed the finish line
+
+    // ---- re-solve from the measured state ----
+    ocp.set_state(x);
+    if (warm) {
+      // previous solution shifted by one sample onto the new, shorter
+      // horizon: node values interpolated at the new node times, interval
+      // values taken from the old interval around the new midpoints
+      const double h_new = (T - Ts) / N;
+      auto shift_nodes = [&](const DM &M) {
+        DM M0 = DM::zeros(M.size1(), N + 1);
+        for (int i = 0; i <= N; ++i) {
+          double q = std::min((Ts + i * h_new) / h, static_cast<double>(N));
+          int j = std::min(static_cast<int>(q), N - 1);
+          double w = q - j;
+          M0(Slice(), i) = (1 - w) * M(Slice(), j) + w * M(Slice(), j + 1);
+        }
+        return M0;
+      };
+      auto shift_intervals = [&](const DM &M) {
+        DM M0 = DM::zeros(M.size1(), N);
+        for (int i = 0; i < N; ++i) {
+          int k = std::min(static_cast<int>((Ts + (i + 0.5) * h_new) / h),
+                           N - 1);
+          M0(Slice(), i) = M(Slice(), k);
+        }
+        return M0;
+      };
+      opti.set_initial(ocp.X, shift_nodes(sol.value(ocp.X)));
+      opti.set_initial(ocp.U, shift_intervals(sol.value(ocp.U)));
+      opti.set_initial(ocp.T_stages, T - Ts);
+
+      // multipliers: all of them from the previous solve, then the path
+      // constraints and gaps shifted like the trajectories; the boundary
+      // conditions keep theirs. The stagewise form has no constraint
+      // groups, its re-solves start from the primal guess only
+      if (!ocp.node_constraints.empty()) {
+        opti.set_initial(opti.lam_g(), sol.value(opti.lam_g()));
+        for (const MX &c : ocp.node_constraints)
+          opti.set_initial(opti.dual(c),
+                           shift_nodes(sol.value(opti.dual(c))));
+        for (const MX &c : ocp.interval_constraints)
+          opti.set_initial(opti.dual(c),
+                           shift_intervals(sol.value(opti.dual(c))));
+      }
+    } else {
+      ocp.set_initial(initial_guess{});
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    try {
+      sol = opti.solve();
+    } catch (const std::exception &e) {
+      std::cout << "solve failed at t = " << t << " s: " << e.what()
+                << std::endl;
+      break;
+    }
+    latency_ms.push_back(
+        ms(std::chrono::steady_clock::now() - start).count());
+    iterations.push_back(sol.stats().at("iter_count").as_int());
+  }
+
+  // ---- report ----
+  double mean_iter = 0.0;
+  for (double n : iterations)
+    mean_iter += n / iterations.size();
+  std::cout << (warm ? "warm" : "cold") << " starts: " << latency_ms.size()
+            << " re-solves, " << mean_iter << " iterations on average"
+            << std::endl;
+  std::cout << "latency p50 " << percentile(latency_ms, 0.5) << " ms, p90 "
+            << percentile(latency_ms, 0.9) << " ms, p99 "
+            << percentile(latency_ms, 0.99) << " ms, max "
+            << percentile(latency_ms, 1.0) << " ms" << std::endl;
+  std::cout << "finished at x = " << xs[xs.size() - 4] << " m, y = "
+            << xs[xs.size() - 3] << " m after " << t << " s" << std::endl;
+
+  // ---- saving the closed-loop run ----
+  const Eigen::Index n_smp = static_cast<Eigen::Index>(ts.size());
+  Eigen::Map<const Eigen::MatrixXd> Xcl(xs.data(), 4, n_smp);
+  Eigen::Map<const Eigen::MatrixXd> Ucl(us.data(), 2, n_smp - 1);
+  NpzWriter npz(warm ? "casadi_mpc_cpp" : "casadi_mpc_cold_cpp");
+  npz.write("t", ts);
+  npz.write("x_pos", Xcl.row(0));
+  npz.write("y_pos", Xcl.row(1));
+  npz.write("x_speed", Xcl.row(2));
+  npz.write("y_speed", Xcl.row(3));
+  npz.write("U0", Ucl.row(0));
+  npz.write("U1", Ucl.row(1));
+  npz.write("latency_ms", latency_ms);
+  npz.write("iterations", iterations);
+
+  return 0;
+}
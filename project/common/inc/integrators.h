@@ -0,0 +1,126 @@
+#ifndef INTEGRATORS_H
+#define INTEGRATORS_H
+
+#include <concepts>
+#include <eigen3/Eigen/Dense>
+#include <utility>
+
+using namespace Eigen;
+
+namespace FixedStepSimulators {
+/*! Fixed-step integrators over a given time grid
+ *
+ * Shared by simple_simulation and pmsm_simulation. x.col(0) holds the initial
+ * state and x.col(ii) is reached from x.col(ii - 1) over the step
+ * t[ii - 1] -> t[ii]. The stage vectors are allocated once per call, as
+ * RungeKutta does in its constructor, so a step does not touch the heap.
+ *
+ * The inputs are either samples, u.col(ii - 1) held over the step, or an
+ * input source such as Signals::Inputs, evaluated at every stage time.
+ *
+ * Example: RungeKutta4(t, x, u, pmsm); // pmsm.fx(t, x, u, xdot)
+ */
+
+/* Model with inputs, ode.fx(t, x, u, xdot) writes dx/dt into xdot */
+template <typename ODE>
+concept InputModel = requires(ODE &ode, double t, const VectorXd &x,
+                              const VectorXd &u, VectorXd &xdot) {
+  ode.fx(t, x, u, xdot);
+};
+
+/* Input source, inputs(t, u) writes the inputs at t, see signals.h */
+template <typename In>
+concept InputSource = requires(const In &inputs, double t, VectorXd &u) {
+  inputs(t, u);
+  { inputs.size() } -> std::convertible_to<Index>;
+};
+
+/* Euler forward method */
+template <InputModel ODE>
+void euler_forward(const VectorXd &t, MatrixXd &x, const MatrixXd &u,
+                   ODE &ode) {
+  VectorXd x_k = x.col(0);
+  VectorXd u_k(u.rows());
+  VectorXd xdot(x.rows());
+  for (Index ii = 1; ii < t.size(); ++ii) {
+    double dt = t[ii] - t[ii - 1];
+    u_k = u.col(ii - 1);
+    ode.fx(t[ii - 1], x_k, u_k, xdot);
+    x_k += dt * xdot;
+    x.col(ii) = x_k;
+  }
+}
+
+/* Classical fourth-order Runge-Kutta method */
+template <InputModel ODE>
+void RungeKutta4(const VectorXd &t, MatrixXd &x, const MatrixXd &u, ODE &ode) {
+  const Index n = x.rows();
+  VectorXd x_k = x.col(0);
+  VectorXd u_k(u.rows());
+  VectorXd k1(n), k2(n), k3(n), k4(n);
+  VectorXd tmp(n);
+  for (Index ii = 1; ii < t.size(); ++ii) {
+    double t_k = t[ii - 1];
+    double dt = t[ii] - t_k;
+    u_k = u.col(ii - 1);
+    ode.fx(t_k, x_k, u_k, k1);
+    tmp.noalias() = x_k + 0.5 * dt * k1;
+    ode.fx(t_k + 0.5 * dt, tmp, u_k, k2);
+    tmp.noalias() = x_k + 0.5 * dt * k2;
+    ode.fx(t_k + 0.5 * dt, tmp, u_k, k3);
+    tmp.noalias() = x_k + dt * k3;
+    ode.fx(t_k + dt, tmp, u_k, k4);
+    x_k += (dt / 6) * (k1 + 2 * k2 + 2 * k3 + k4);
+    x.col(ii) = x_k;
+  }
+}
+
+/* Euler forward method, inputs evaluated at the start of every step */
+template <InputModel ODE, InputSource In>
+void euler_forward(const VectorXd &t, MatrixXd &x, const In &inputs,
+                   ODE &ode) {
+  VectorXd x_k = x.col(0);
+  VectorXd u_k(inputs.size());
+  VectorXd xdot(x.rows());
+  for (Index ii = 1; ii < t.size(); ++ii) {
+    double dt = t[ii] - t[ii - 1];
+    inputs(t[ii - 1], u_k);
+    ode.fx(t[ii - 1], x_k, u_k, xdot);
+    x_k += dt * xdot;
+    x.col(ii) = x_k;
+  }
+}
+
+/* Classical fourth-order Runge-Kutta method, inputs evaluated at the stage
+ * times t, t + dt/2 and t + dt. The end of a step is the start of the next,
+ * so there are two input evaluations per step. */
+template <InputModel ODE, InputSource In>
+void RungeKutta4(const VectorXd &t, MatrixXd &x, const In &inputs, ODE &ode) {
+  const Index n = x.rows();
+  VectorXd x_k = x.col(0);
+  VectorXd u_a(inputs.size()), u_m(inputs.size()), u_b(inputs.size());
+  VectorXd k1(n), k2(n), k3(n), k4(n);
+  VectorXd tmp(n);
+  if (t.size() > 0)
+    inputs(t[0], u_a);
+  for (Index ii = 1; ii < t.size(); ++ii) {
+    double t_k = t[ii - 1];
+    double dt = t[ii] - t_k;
+    inputs(t_k + 0.5 * dt, u_m);
+    inputs(t[ii], u_b);
+    ode.fx(t_k, x_k, u_a, k1);
+    tmp.noalias() = x_k + 0.5 * dt * k1;
+    ode.fx(t_k + 0.5 * dt, tmp, u_m, k2);
+    tmp.noalias() = x_k + 0.5 * dt * k2;
+    ode.fx(t_k + 0.5 * dt, tmp, u_m, k3);
+    tmp.noalias() = x_k + dt * k3;
+    ode.fx(t[ii], tmp, u_b, k4);
+    x_k += (dt / 6) * (k1 + 2 * k2 + 2 * k3 + k4);
+    x.col(ii) = x_k;
+    u_a.swap(u_b); // inputs at t[ii], the next step's start
+  }
+}
+
+} // namespace FixedStepSimulators
+
+#endif // INTEGRATORS_H
@@ -0,0 +1,263 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <eigen3/Eigen/Dense>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "profiler.h" // PROFILE_ZONE
+
+using nljson = nlohmann::json;
+
+/* ---------------------------------------------------- */
+/* Streaming JSON writer */
+/* ---------------------------------------------------- */
+// Writes JSON straight to the file as it is produced, no nljson tree and no
+// full output string are held in memory. Doubles are printed with
+// std::to_chars, the shortest representation that reads back to the same
+// value. indent < 0 writes compact JSON, indent >= 0 one element per line.
+//
+// Example:
+//   JsonWriter json("pmsm_sim_cpp"); // writes pmsm_sim_cpp.json
+//   json.begin_object();
+//   json.field("t", ts);
+//   json.field("x0", xs.row(0));
+//   json.end_object();
+class JsonWriter {
+public:
+  explicit JsonWriter(std::string filename, int indent = -1,
+                      size_t buffer_size = 1 << 20)
+      : filename(std::move(filename) + ".json"), indent(indent),
+        capacity(buffer_size) {
+    buffer.reserve(capacity + 64);
+    file.open(this->filename, std::ios::binary);
+    if (!file.is_open())
+      std::cerr << "Unable to open file for writing" << std::endl;
+  }
+
+  JsonWriter(const JsonWriter &) = delete;
+  JsonWriter &operator=(const JsonWriter &) = delete;
+
+  ~JsonWriter() { close(); }
+
+  JsonWriter &begin_object() { return open('{'); }
+  JsonWriter &end_object() { return close_scope('}'); }
+  JsonWriter &begin_array() { return open('['); }
+  JsonWriter &end_array() { return close_scope(']'); }
+
+  JsonWriter &key(std::string_view name) {
+    separator();
+    string(name);
+    put(':');
+    if (indent >= 0)
+      put(' ');
+    after_key = true;
+    return *this;
+  }
+
+  JsonWriter &value(double v) {
+    separator();
+    number(v);
+    return *this;
+  }
+
+  JsonWriter &value(long long v) {
+    separator();
+    char buf[24];
+    auto res = std::to_chars(buf, buf + sizeof(buf), v);
+    append(buf, res.ptr - buf);
+    return *this;
+  }
+
+  JsonWriter &value(int v) { return value(static_cast<long long>(v)); }
+
+  JsonWriter &value(std::string_view v) {
+    separator();
+    string(v);
+    return *this;
+  }
+
+  /* Eigen vector / row / column as a JSON array */
+  template <typename Derived>
+  JsonWriter &value(const Eigen::DenseBase<Derived> &v) {
+    PROFILE_ZONE("JsonWriter::array");
+    begin_array();
+    for (Eigen::Index i = 0; i < v.size(); ++i) {
+      if (i > 0)
+        buffer.push_back(',');
+      newline();
+      number(static_cast<double>(v(i)));
+    }
+    first.back() = v.size() == 0;
+    return end_array();
+  }
+
+  JsonWriter &value(const std::vector<double> &v) {
+    return value(Eigen::Map<const Eigen::VectorXd>(v.data(), v.size()));
+  }
+
+  /* "name": value */
+  template <typename T> JsonWriter &field(std::string_view name, const T &v) {
+    key(name);
+    return value(v);
+  }
+
+  /* Flush and close the file */
+  void close() {
+    if (!file.is_open())
+      return;
+    flush();
+    file.close();
+    std::cout << "saved to " << filename << std::endl;
+  }
+
+private:
+  JsonWriter &open(char c) {
+    separator();
+    put(c);
+    first.push_back(true);
+    return *this;
+  }
+
+  JsonWriter &close_scope(char c) {
+    bool empty = first.back();
+    first.pop_back();
+    if (!empty)
+      newline();
+    put(c);
+    return *this;
+  }
+
+  // comma and line break before a new element
+  void separator() {
+    if (after_key) {
+      after_key = false;
+      return;
+    }
+    if (first.empty())
+      return;
+    if (!first.back())
+      put(',');
+    first.back() = false;
+    newline();
+  }
+
+  void newline() {
+    if (indent < 0)
+      return;
+    put('\n');
+    buffer.append(first.size() * indent, ' ');
+  }
+
+  void number(double v) {
+    if (!std::isfinite(v)) {
+      append("null", 4); // as nljson does
+      return;
+    }
+    char buf[32];
+    auto res = std::to_chars(buf, buf + sizeof(buf), v);
+    append(buf, res.ptr - buf);
+  }
+
+  void string(std::string_view s) {
+    put('"');
+    for (char c : s) {
+      if (c == '"' || c == '\\') {
+        put('\\');
+        put(c);
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        char buf[8];
+        std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+        append(buf, 6);
+      } else {
+        put(c);
+      }
+    }
+    put('"');
+  }
+
+  void put(char c) {
+    buffer.push_back(c);
+    if (buffer.size() >= capacity)
+      flush();
+  }
+
+  void append(const char *s, size_t n) {
+    buffer.append(s, n);
+    if (buffer.size() >= capacity)
+      flush();
+  }
+
+  void flush() {
+    PROFILE_ZONE("JsonWriter::flush");
+    file.write(buffer.data(), buffer.size());
+    buffer.clear();
+  }
+
+  std::string filename;
+  int indent;
+  size_t capacity;
+  std::string buffer;
+  std::ofstream file;
+  std::vector<bool> first; // per open scope: no element written yet
+  bool after_key{false};
+};
+/* ---------------------------------------------------- */
+
+/* ---------------------------------------------------- */
+/* Solver sink writing one [t, x0, x1, ...] row per sample */
+/* ---------------------------------------------------- */
+// The caller opens the enclosing array, e.g.
+//   json.begin_object().key("samples").begin_array();
+//   rk.solve(t0, T, x0, dt, JsonTrajectorySink(json));
+//   json.end_array().end_object();
+class JsonTrajectorySink {
+public:
+  explicit JsonTrajectorySink(JsonWriter &json) : json(json) {}
+
+  template <typename Derived>
+  void operator()(double t, const Eigen::MatrixBase<Derived> &x) {
+    json.begin_array().value(t);
+    for (Eigen::Index i = 0; i < x.size(); ++i)
+      json.value(static_cast<double>(x(i)));
+    json.end_array();
+  }
+
+private:
+  JsonWriter &json;
+};
+/* ---------------------------------------------------- */
+
+/* ---------------------------------------------------- */
+/* Function to create a json file from an nljson tree */
+/* ---------------------------------------------------- */
+// Shared replacement of the per-file helpers. The tree is streamed to the
+// file instead of being dumped to a string first, compact unless indent >= 0.
+inline void create_jsonfile(std::string filename, const nljson &json_obj,
+                            int indent = -1) {
+  PROFILE_ZONE("create_jsonfile");
+
+  filename += ".json"; // Append .json to filename
+
+  std::ofstream file(filename);
+  if (file.is_open()) {
+    if (indent >= 0)
+      file << std::setw(indent);
+    file << json_obj;
+    file.close();
+    std::cout << "saved to " << filename << std::endl;
+  } else {
+    std::cerr << "Unable to open file for writing" << std::endl;
+  }
+}
+/* ---------------------------------------------------- */
+
+#endif // JSON_WRITER_H
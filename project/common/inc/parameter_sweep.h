@@ -0,0 +1,151 @@
+#ifndef PARAMETER_SWEEP_H
+#define PARAMETER_SWEEP_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*! Multi-threaded parameter sweeps
+ *
+ * Jobs 0..n_jobs-1 are split into one contiguous range per worker. A worker
+ * takes jobs from the front of its own range and, when that is empty, steals
+ * the back half of the largest remaining range, so uneven job costs still
+ * keep every core busy. Every worker creates its context (model, solver,
+ * scratch buffers) once and reuses it for all the jobs it runs. Results are
+ * stored by job index, so the output order does not depend on scheduling.
+ */
+
+struct SweepOptions {
+  unsigned n_threads{0}; // 0 -> std::thread::hardware_concurrency()
+  // called from the calling thread every progress_interval with the number
+  // of finished jobs and the elapsed time in seconds
+  std::function<void(size_t, size_t, double)> progress;
+  std::chrono::milliseconds progress_interval{1000};
+};
+
+/* Range of jobs owned by one worker */
+class JobRange {
+public:
+  void assign(size_t b, size_t e) {
+    std::lock_guard<std::mutex> lock(mutex);
+    begin = b;
+    end = e;
+  }
+
+  // take the next job from the front, false if empty
+  bool pop(size_t &job) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (begin == end)
+      return false;
+    job = begin++;
+    return true;
+  }
+
+  // give away the back half (or the last job), false if empty
+  bool steal(size_t &b, size_t &e) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t n = end - begin;
+    if (n == 0)
+      return false;
+    b = begin + n / 2;
+    e = end;
+    end = b;
+    return true;
+  }
+
+  size_t size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return end - begin;
+  }
+
+private:
+  std::mutex mutex;
+  size_t begin{0};
+  size_t end{0};
+};
+
+/* Run a sweep
+ *
+ * make_worker: () -> Context, called once per worker thread; the context is
+ *              initialized from the returned prvalue, so it may be neither
+ *              copyable nor movable
+ * run:         (Context &, size_t job) -> Result
+ */
+template <typename Result, typename MakeWorker, typename Run>
+auto run_sweep(size_t n_jobs, MakeWorker make_worker, Run run,
+               const SweepOptions &opts = {}) -> std::vector<Result> {
+
+  unsigned n_threads = opts.n_threads;
+  if (n_threads == 0)
+    n_threads = std::max(1u, std::thread::hardware_concurrency());
+  n_threads = std::max<size_t>(1, std::min<size_t>(n_threads, n_jobs));
+
+  std::vector<Result> results(n_jobs);
+  std::vector<JobRange> ranges(n_threads);
+  for (unsigned w = 0; w < n_threads; ++w)
+    ranges[w].assign(n_jobs * w / n_threads, n_jobs * (w + 1) / n_threads);
+
+  std::atomic<size_t> n_done{0};
+  std::mutex done_mutex;
+  std::condition_variable done_cv;
+
+  auto worker = [&](unsigned w) {
+    auto context = make_worker();
+    size_t job;
+    while (true) {
+      while (ranges[w].pop(job)) {
+        results[job] = run(context, job);
+        if (n_done.fetch_add(1) + 1 == n_jobs) {
+          std::lock_guard<std::mutex> lock(done_mutex);
+          done_cv.notify_all();
+        }
+      }
+
+      // own range empty, steal from the fullest other range
+      unsigned victim = w;
+      size_t most = 0;
+      for (unsigned v = 0; v < n_threads; ++v) {
+        size_t n = v == w ? 0 : ranges[v].size();
+        if (n > most) {
+          most = n;
+          victim = v;
+        }
+      }
+      if (most == 0)
+        return; // nothing left anywhere
+      size_t b, e;
+      if (ranges[victim].steal(b, e))
+        ranges[w].assign(b, e);
+    }
+  };
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (unsigned w = 0; w < n_threads; ++w)
+    threads.emplace_back(worker, w);
+
+  if (opts.progress) {
+    std::unique_lock<std::mutex> lock(done_mutex);
+    bool finished = false;
+    while (!finished) {
+      finished = done_cv.wait_for(lock, opts.progress_interval,
+                                  [&] { return n_done.load() == n_jobs; });
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      opts.progress(n_done.load(), n_jobs, elapsed.count());
+    }
+  }
+
+  for (auto &thread : threads)
+    thread.join();
+
+  return results;
+}
+
+#endif // PARAMETER_SWEEP_H
@@ -0,0 +1,234 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* ---------------------------------------------------- */
+/* Scoped profiling zones */
+/* ---------------------------------------------------- */
+// PROFILE_ZONE("name") times the rest of the enclosing scope. Zones nest, and
+// every zone keeps count / total / self / min / mean / p99 / max statistics.
+// At exit a flat profile is printed and a Chrome trace (chrome://tracing or
+// https://ui.perfetto.dev) is written to profile_trace.json.
+//
+// The zones compile to nothing unless PROFILE_ENABLED is defined, see the
+// PMSM_PROFILE option in CMakeLists.txt.
+
+#ifdef PROFILE_ENABLED
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_ZONE(name)                                                     \
+  static Profiler::Zone &PROFILE_CONCAT(profile_zone_, __LINE__) =             \
+      Profiler::instance().zone(name);                                         \
+  Profiler::Scope PROFILE_CONCAT(profile_scope_, __LINE__)(                    \
+      PROFILE_CONCAT(profile_zone_, __LINE__))
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#endif
+
+class Profiler {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  /* Statistics of one named zone, updated lock-free from any thread */
+  struct Zone {
+    explicit Zone(std::string name, uint32_t id)
+        : name(std::move(name)), id(id) {}
+
+    void record(uint64_t ns, uint64_t self_ns) {
+      count.fetch_add(1, std::memory_order_relaxed);
+      total.fetch_add(ns, std::memory_order_relaxed);
+      self.fetch_add(self_ns, std::memory_order_relaxed);
+      uint64_t m = min.load(std::memory_order_relaxed);
+      while (ns < m && !min.compare_exchange_weak(m, ns))
+        ;
+      m = max.load(std::memory_order_relaxed);
+      while (ns > m && !max.compare_exchange_weak(m, ns))
+        ;
+      histogram[bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // upper bound of the q-quantile from the histogram
+    uint64_t quantile(double q) const {
+      uint64_t n = count.load(), target = static_cast<uint64_t>(q * n), seen = 0;
+      for (size_t b = 0; b < histogram.size(); ++b) {
+        seen += histogram[b].load();
+        if (seen > target)
+          return std::min(upper(b), max.load());
+      }
+      return max.load();
+    }
+
+    std::string name;
+    uint32_t id;
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> total{0}; // ns, inclusive
+    std::atomic<uint64_t> self{0};  // ns, without nested zones
+    std::atomic<uint64_t> min{UINT64_MAX};
+    std::atomic<uint64_t> max{0};
+    // log-linear buckets, 4 per power of two
+    std::array<std::atomic<uint64_t>, 256> histogram{};
+
+  private:
+    static size_t bucket(uint64_t ns) {
+      if (ns < 4)
+        return ns;
+      int msb = 63 - __builtin_clzll(ns);
+      return std::min<size_t>(4 * (msb - 1) + ((ns >> (msb - 2)) & 3), 255);
+    }
+    static uint64_t upper(size_t b) {
+      if (b < 4)
+        return b;
+      int msb = static_cast<int>(b / 4) + 1;
+      return ((4 + b % 4 + 1) << (msb - 2)) - 1;
+    }
+  };
+
+  /* RAII timer of one zone */
+  class Scope {
+  public:
+    explicit Scope(Zone &zone) : zone(zone), start(now()) {
+      parent = current;
+      current = this;
+    }
+    ~Scope() {
+      uint64_t end = now();
+      uint64_t ns = end - start;
+      zone.record(ns, ns - children);
+      if (parent)
+        parent->children += ns;
+      current = parent;
+      Profiler::instance().trace(zone.id, start, ns);
+    }
+
+  private:
+    Zone &zone;
+    uint64_t start;
+    uint64_t children{0};
+    Scope *parent{nullptr};
+    static inline thread_local Scope *current = nullptr;
+  };
+
+  static Profiler &instance() {
+    static Profiler profiler;
+    return profiler;
+  }
+
+  /* Zone by name, created on first use; the name is compared in place, so
+   * looking up an existing zone does not allocate */
+  Zone &zone(const char *name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (Zone &z : zones)
+      if (z.name == name)
+        return z;
+    return zones.emplace_back(name, static_cast<uint32_t>(zones.size()));
+  }
+
+  static uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               Clock::now().time_since_epoch())
+        .count();
+  }
+
+  std::string trace_file{"profile_trace.json"};
+  size_t max_trace_events{1 << 20}; // per thread, later events are dropped
+
+  ~Profiler() {
+    print();
+    write_trace();
+  }
+
+  /* Flat profile, sorted by self time */
+  void print() const {
+    std::vector<const Zone *> sorted;
+    for (const Zone &z : zones)
+      if (z.count.load() > 0)
+        sorted.push_back(&z);
+    std::sort(sorted.begin(), sorted.end(), [](auto a, auto b) {
+      return a->self.load() > b->self.load();
+    });
+
+    std::printf("%-28s %10s %11s %11s %9s %9s %9s %9s\n", "zone", "count",
+                "total ms", "self ms", "min us", "mean us", "p99 us",
+                "max us");
+    for (const Zone *z : sorted) {
+      double n = static_cast<double>(z->count.load());
+      std::printf("%-28s %10llu %11.3f %11.3f %9.3f %9.3f %9.3f %9.3f\n",
+                  z->name.c_str(),
+                  static_cast<unsigned long long>(z->count.load()),
+                  z->total.load() * 1e-6, z->self.load() * 1e-6,
+                  z->min.load() * 1e-3, z->total.load() * 1e-3 / n,
+                  z->quantile(0.99) * 1e-3, z->max.load() * 1e-3);
+    }
+  }
+
+private:
+  struct Event {
+    uint32_t zone;
+    uint64_t start;
+    uint64_t duration;
+  };
+  struct ThreadTrace {
+    uint32_t tid;
+    std::vector<Event> events;
+  };
+
+  Profiler() : t0(now()) {}
+
+  void trace(uint32_t zone_id, uint64_t start, uint64_t ns) {
+    thread_local ThreadTrace *local = register_thread();
+    if (local->events.size() < max_trace_events)
+      local->events.push_back({zone_id, start, ns});
+  }
+
+  // the buffer is reserved once, so tracing never reallocates inside a zone
+  ThreadTrace *register_thread() {
+    std::lock_guard<std::mutex> lock(mutex);
+    threads.push_back(std::make_unique<ThreadTrace>());
+    threads.back()->tid = static_cast<uint32_t>(threads.size());
+    threads.back()->events.reserve(max_trace_events);
+    return threads.back().get();
+  }
+
+  void write_trace() const {
+    if (trace_file.empty() || threads.empty())
+      return;
+    std::FILE *file = std::fopen(trace_file.c_str(), "w");
+    if (!file)
+      return;
+    std::fputs("{\"traceEvents\":[", file);
+    bool first = true;
+    for (const auto &thread : threads) {
+      for (const Event &e : thread->events) {
+        std::fprintf(file,
+                     "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                     "\"ts\":%.3f,\"dur\":%.3f}",
+                     first ? "" : ",", zones[e.zone].name.c_str(), thread->tid,
+                     (e.start - t0) * 1e-3, e.duration * 1e-3);
+        first = false;
+      }
+    }
+    std::fputs("\n]}\n", file);
+    std::fclose(file);
+    std::printf("saved to %s\n", trace_file.c_str());
+  }
+
+  std::mutex mutex;
+  std::deque<Zone> zones; // deque, references stay valid as zones are added
+  std::vector<std::unique_ptr<ThreadTrace>> threads;
+  uint64_t t0;
+};
+/* ---------------------------------------------------- */
+
+#endif // PROFILER_H
@@ -0,0 +1,150 @@
+#ifndef SIGNALS_H
+#define SIGNALS_H
+
+#include <algorithm>
+#include <cmath>
+#include <eigen3/Eigen/Dense>
+#include <functional>
+#include <numbers>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using namespace Eigen;
+
+namespace Signals {
+/*! Input signals evaluated on demand
+ *
+ * A Signal is a function of time, evaluated by the integrators at the stage
+ * times, so no input samples are stored and the memory does not grow with
+ * the number of steps. Signals compose with +, - and scalar *, and Inputs
+ * bundles one signal per model input.
+ *
+ * Example: Inputs u(3);                        // vd, vq, Tl
+ *          u[1] = step(0.2, 200.0);            // vq
+ *          u[2] = ramp(0.5, 0.6, 0.0, 10.0);   // Tl
+ *          RungeKutta4(t, x, u, pmsm);
+ */
+class Signal {
+public:
+  Signal() : Signal(0.0) {}
+  Signal(double value) // a constant, implicit so numbers compose
+      : f([value](double) { return value; }) {}
+  explicit Signal(std::function<double(double)> f) : f(std::move(f)) {}
+
+  double operator()(double t) const { return f(t); }
+
+  friend Signal operator+(Signal a, Signal b) {
+    return Signal([a = std::move(a), b = std::move(b)](double t) {
+      return a(t) + b(t);
+    });
+  }
+  friend Signal operator-(Signal a, Signal b) {
+    return Signal([a = std::move(a), b = std::move(b)](double t) {
+      return a(t) - b(t);
+    });
+  }
+  friend Signal operator*(double k, Signal a) {
+    return Signal([k, a = std::move(a)](double t) { return k * a(t); });
+  }
+
+private:
+  std::function<double(double)> f;
+};
+
+/* value for t > t0, initial up to and including t0, as UnitStep was */
+inline Signal step(double t0, double value, double initial = 0.0) {
+  return Signal([=](double t) { return t > t0 ? value : initial; });
+}
+
+/* v0 up to t0, linear from v0 to v1 over [t0, t1], v1 after t1 */
+inline Signal ramp(double t0, double t1, double v0, double v1) {
+  if (!(t1 > t0))
+    throw std::invalid_argument("ramp: t1 must be after t0");
+  return Signal([=](double t) {
+    if (t <= t0)
+      return v0;
+    if (t >= t1)
+      return v1;
+    return v0 + (v1 - v0) * (t - t0) / (t1 - t0);
+  });
+}
+
+/* offset + amplitude sin(2 pi f t + phase) */
+inline Signal sine(double amplitude, double f, double phase = 0.0,
+                   double offset = 0.0) {
+  return Signal([=](double t) {
+    return offset + amplitude * std::sin(2 * std::numbers::pi * f * t + phase);
+  });
+}
+
+namespace detail {
+inline void check_table(const std::vector<double> &times,
+                        const std::vector<double> &values) {
+  if (times.empty() || times.size() != values.size())
+    throw std::invalid_argument(
+        "signal table: times and values must be non-empty and equal length");
+  if (!std::is_sorted(times.begin(), times.end()))
+    throw std::invalid_argument("signal table: times must be sorted");
+}
+} // namespace detail
+
+/* values[k] on [times[k], times[k + 1]), zero before times[0] */
+inline Signal piecewise_constant(std::vector<double> times,
+                                 std::vector<double> values) {
+  detail::check_table(times, values);
+  return Signal([times = std::move(times),
+                 values = std::move(values)](double t) {
+    auto it = std::upper_bound(times.begin(), times.end(), t);
+    return it == times.begin() ? 0.0 : values[it - times.begin() - 1];
+  });
+}
+
+/* linear interpolation in (times, values), the end values are held outside
+ * the table */
+inline Signal table(std::vector<double> times, std::vector<double> values) {
+  detail::check_table(times, values);
+  return Signal([times = std::move(times),
+                 values = std::move(values)](double t) {
+    if (t <= times.front())
+      return values.front();
+    if (t >= times.back())
+      return values.back();
+    size_t k = std::upper_bound(times.begin(), times.end(), t) - times.begin();
+    double s = (t - times[k - 1]) / (times[k] - times[k - 1]);
+    return values[k - 1] + s * (values[k] - values[k - 1]);
+  });
+}
+
+/* One signal per model input, inputs(t, u) writes all of them at t */
+class Inputs {
+public:
+  explicit Inputs(size_t m) : signals(m) {}
+
+  Signal &operator[](size_t k) { return signals[k]; }
+  const Signal &operator[](size_t k) const { return signals[k]; }
+
+  template <typename Derived>
+  void operator()(double t, MatrixBase<Derived> &u) const {
+    for (size_t k = 0; k < signals.size(); ++k)
+      u(k) = signals[k](t);
+  }
+
+  /* Samples at the times t, one row per input, for plots and output */
+  MatrixXd sample(const VectorXd &t) const {
+    MatrixXd u(size(), t.size());
+    for (Index ii = 0; ii < t.size(); ++ii)
+      for (Index k = 0; k < size(); ++k)
+        u(k, ii) = signals[k](t[ii]);
+    return u;
+  }
+
+  Index size() const { return static_cast<Index>(signals.size()); }
+
+private:
+  std::vector<Signal> signals;
+};
+
+} // namespace Signals
+
+#endif // SIGNALS_H
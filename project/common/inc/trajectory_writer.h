@@ -0,0 +1,279 @@
+#ifndef TRAJECTORY_WRITER_H
+#define TRAJECTORY_WRITER_H
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <eigen3/Eigen/Dense>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "profiler.h" // PROFILE_ZONE
+
+/* ---------------------------------------------------- */
+/* Binary trajectory writer, NumPy .npz */
+/* ---------------------------------------------------- */
+// Every channel (time, one state, one input, ...) is written as its own
+// float64 .npy array inside an uncompressed .npz archive, streamed column by
+// column through one large buffer. Members and archives past 4 GB get ZIP64
+// records. Load it with
+//   data = np.load("file.npz"); t = data["t"]
+//
+// Example:
+//   NpzWriter npz("pmsm_sim_cpp"); // writes pmsm_sim_cpp.npz
+//   npz.write("t", ts);
+//   npz.write("x0", xs.row(0));
+//   npz.close();                   // or let the destructor do it
+
+static_assert(std::endian::native == std::endian::little,
+              "NpzWriter writes the host byte order as little-endian");
+
+class NpzWriter {
+public:
+  explicit NpzWriter(std::string filename, size_t buffer_size = 1 << 20)
+      : filename(std::move(filename) + ".npz"), buffer(buffer_size) {
+    file.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+    file.open(this->filename, std::ios::binary);
+    if (!file.is_open())
+      std::cerr << "Unable to open file for writing" << std::endl;
+  }
+
+  NpzWriter(const NpzWriter &) = delete;
+  NpzWriter &operator=(const NpzWriter &) = delete;
+
+  ~NpzWriter() { close(); }
+
+  /* Write a vector / Eigen row / Eigen column as a 1-d array */
+  template <typename Derived>
+  void write(const std::string &name, const Eigen::DenseBase<Derived> &v) {
+    std::string shape = "(";
+    shape += std::to_string(v.size());
+    shape += ",)";
+    write_entry(name, shape, v.size(),
+                [&](Eigen::Index i) { return static_cast<double>(v(i)); });
+  }
+
+  void write(const std::string &name, const std::vector<double> &v) {
+    write(name, Eigen::Map<const Eigen::VectorXd>(v.data(), v.size()));
+  }
+
+  /* Write a matrix as a 2-d array, rows x cols in C order */
+  template <typename Derived>
+  void write_matrix(const std::string &name,
+                    const Eigen::DenseBase<Derived> &m) {
+    const Eigen::Index cols = m.cols();
+    std::string shape = "(";
+    shape += std::to_string(m.rows());
+    shape += ", ";
+    shape += std::to_string(cols);
+    shape += ")";
+    write_entry(name, shape, m.size(), [&](Eigen::Index i) {
+      return static_cast<double>(m(i / cols, i % cols));
+    });
+  }
+
+  /* Write a scalar as a 0-d array */
+  void write(const std::string &name, double value) {
+    write_entry(name, "()", 1, [&](Eigen::Index) { return value; });
+  }
+
+  /* Write the central directory and close the file */
+  void close() {
+    if (!file.is_open())
+      return;
+
+    uint64_t cd_offset = file.tellp();
+    for (const Entry &e : entries) {
+      // sizes and offset past 32 bits move to the ZIP64 extra field
+      bool big_size = e.size >= zip32_max, big_offset = e.offset >= zip32_max;
+      uint16_t extra = 8 * (2 * big_size + big_offset);
+      put32(0x02014b50);      // central directory header
+      put16(extra ? 45 : 20); // version made by
+      put16(extra ? 45 : 20); // version needed
+      put16(0);               // flags
+      put16(0);               // stored, no compression
+      put16(0);               // time
+      put16(0x21);            // date, 1980-01-01
+      put32(e.crc);
+      put32(big_size ? zip32_max : e.size);
+      put32(big_size ? zip32_max : e.size);
+      put16(e.name.size());
+      put16(extra ? 4 + extra : 0); // extra field length
+      put16(0);                     // comment length
+      put16(0);                     // disk number
+      put16(0);                     // internal attributes
+      put32(0);                     // external attributes
+      put32(big_offset ? zip32_max : e.offset);
+      file.write(e.name.data(), e.name.size());
+      if (extra) {
+        put16(0x0001); // ZIP64 extended information
+        put16(extra);
+        if (big_size) {
+          put64(e.size);
+          put64(e.size);
+        }
+        if (big_offset)
+          put64(e.offset);
+      }
+    }
+    uint64_t cd_end = file.tellp();
+    uint64_t cd_size = cd_end - cd_offset;
+
+    // ZIP64 end of central directory record and locator, when any of the
+    // fields below overflows
+    bool zip64 = entries.size() >= 0xffff || cd_size >= zip32_max ||
+                 cd_offset >= zip32_max;
+    if (zip64) {
+      put32(0x06064b50); // ZIP64 end of central directory
+      put64(44);         // size of the remaining record
+      put16(45);         // version made by
+      put16(45);         // version needed
+      put32(0);          // this disk
+      put32(0);          // disk of the central directory
+      put64(entries.size());
+      put64(entries.size());
+      put64(cd_size);
+      put64(cd_offset);
+      put32(0x07064b50); // ZIP64 end of central directory locator
+      put32(0);          // disk of the ZIP64 record
+      put64(cd_end);
+      put32(1); // number of disks
+    }
+
+    put32(0x06054b50); // end of central directory
+    put16(0);
+    put16(0);
+    put16(zip64 ? 0xffff : entries.size());
+    put16(zip64 ? 0xffff : entries.size());
+    put32(zip64 ? zip32_max : cd_size);
+    put32(zip64 ? zip32_max : cd_offset);
+    put16(0);
+
+    file.close();
+    std::cout << "saved to " << filename << std::endl;
+  }
+
+private:
+  static constexpr uint32_t zip32_max = 0xffffffffu; // marks a ZIP64 field
+
+  struct Entry {
+    std::string name;
+    uint64_t offset;
+    uint64_t size;
+    uint32_t crc;
+  };
+
+  // one .npy member, values are pulled through value(i) and streamed
+  template <typename Value>
+  void write_entry(const std::string &name, const std::string &shape,
+                   Eigen::Index n, Value value) {
+    PROFILE_ZONE("NpzWriter::write");
+    if (!file.is_open())
+      return;
+
+    // .npy header, padded so the data starts 64-byte aligned
+    std::string header = "{'descr': '<f8', 'fortran_order': False, 'shape': " +
+                         shape + ", }";
+    size_t total = 10 + header.size() + 1;
+    header.append((64 - total % 64) % 64, ' ');
+    header += '\n';
+    std::string preamble("\x93NUMPY\x01\x00", 8); // magic, version 1.0
+    preamble += static_cast<char>(header.size() & 0xff);
+    preamble += static_cast<char>(header.size() >> 8);
+    preamble += header;
+
+    Entry e{name + ".npy", static_cast<uint64_t>(file.tellp()),
+            preamble.size() + 8 * static_cast<uint64_t>(n), 0};
+
+    // local file header, the CRC is patched in once the data is written;
+    // members of 4 GB or more carry their sizes in a ZIP64 extra field
+    bool big_size = e.size >= zip32_max;
+    put32(0x04034b50);
+    put16(big_size ? 45 : 20); // version needed
+    put16(0);                  // flags
+    put16(0);                  // stored, no compression
+    put16(0);                  // time
+    put16(0x21);               // date, 1980-01-01
+    put32(0);                  // crc, patched below
+    put32(big_size ? zip32_max : e.size);
+    put32(big_size ? zip32_max : e.size);
+    put16(e.name.size());
+    put16(big_size ? 20 : 0); // extra field length
+    file.write(e.name.data(), e.name.size());
+    if (big_size) {
+      put16(0x0001); // ZIP64 extended information
+      put16(16);
+      put64(e.size);
+      put64(e.size);
+    }
+
+    uint32_t crc = crc32(0xffffffffu, preamble.data(), preamble.size());
+    file.write(preamble.data(), preamble.size());
+
+    // stream the values through a small staging block
+    std::array<double, 1024> block;
+    for (Eigen::Index i = 0; i < n; i += block.size()) {
+      Eigen::Index m = std::min<Eigen::Index>(block.size(), n - i);
+      for (Eigen::Index j = 0; j < m; ++j)
+        block[j] = value(i + j);
+      crc = crc32(crc, block.data(), 8 * m);
+      file.write(reinterpret_cast<const char *>(block.data()), 8 * m);
+    }
+    e.crc = ~crc;
+
+    auto end = file.tellp();
+    file.seekp(e.offset + 14);
+    put32(e.crc);
+    file.seekp(end);
+
+    entries.push_back(std::move(e));
+  }
+
+  // CRC-32 (zip polynomial), slicing-by-8
+  static uint32_t crc32(uint32_t crc, const void *data, size_t n) {
+    static const auto table = [] {
+      std::array<std::array<uint32_t, 256>, 8> t{};
+      for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; ++k)
+          c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        t[0][i] = c;
+      }
+      for (uint32_t i = 0; i < 256; ++i)
+        for (int s = 1; s < 8; ++s)
+          t[s][i] = (t[s - 1][i] >> 8) ^ t[0][t[s - 1][i] & 0xff];
+      return t;
+    }();
+    auto p = static_cast<const unsigned char *>(data);
+    for (; n >= 8; n -= 8, p += 8) {
+      uint32_t lo, hi;
+      std::memcpy(&lo, p, 4);
+      std::memcpy(&hi, p + 4, 4);
+      lo ^= crc;
+      crc = table[7][lo & 0xff] ^ table[6][(lo >> 8) & 0xff] ^
+            table[5][(lo >> 16) & 0xff] ^ table[4][lo >> 24] ^
+            table[3][hi & 0xff] ^ table[2][(hi >> 8) & 0xff] ^
+            table[1][(hi >> 16) & 0xff] ^ table[0][hi >> 24];
+    }
+    for (; n > 0; --n, ++p)
+      crc = table[0][(crc ^ *p) & 0xff] ^ (crc >> 8);
+    return crc;
+  }
+
+  void put16(uint16_t v) { file.write(reinterpret_cast<const char *>(&v), 2); }
+  void put32(uint32_t v) { file.write(reinterpret_cast<const char *>(&v), 4); }
+  void put64(uint64_t v) { file.write(reinterpret_cast<const char *>(&v), 8); }
+
+  std::string filename;
+  std::vector<char> buffer;
+  std::ofstream file;
+  std::vector<Entry> entries;
+};
+/* ---------------------------------------------------- */
+
+#endif // TRAJECTORY_WRITER_H
@@ -0,0 +1,284 @@
+#include <atomic>
+#include <benchmark/benchmark.h>
+#include <eigen3/Eigen/Dense>
+#include <iostream>
+#include <nlohmann/json.hpp>
+#include <string>
+
+#include "implicit_simulators.h" // Rosenbrock
+#include "integrators.h"         // euler_forward, RungeKutta4
+#include "json_writer.h"         // Streaming JSON output
+#include "pmsm.h"                // PMSM, PMSMController
+#include "pmsm_models.h"         // PMSMOpenLoop
+#include "simulators.h"          // Fixed-step simulators
+#include "trajectory_writer.h"   // Binary trajectory output
+
+using namespace Eigen;
+using nljson = nlohmann::json;
+
+// Count heap allocations. Eigen allocates through std::malloc and not through
+// operator new, so malloc itself is wrapped (glibc only).
+static std::atomic<long> n_allocations{0}; // any thread may allocate
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *malloc(size_t size) {
+  n_allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_malloc(size);
+}
+
+// Reports allocations per iteration next to the timing. Everything between
+// construction and the end of the benchmark loop is counted.
+class AllocationCounter {
+public:
+  explicit AllocationCounter(benchmark::State &state)
+      : state(state), start(n_allocations) {}
+  ~AllocationCounter() {
+    state.counters["allocs"] = benchmark::Counter(
+        static_cast<double>(n_allocations - start),
+        benchmark::Counter::kAvgIterations);
+  }
+
+private:
+  benchmark::State &state;
+  long start;
+};
+
+/* ---------------------------------------------------- */
+/* simple_simulation PMSM, same state equations as main.cc there */
+/* ---------------------------------------------------- */
+struct SimplePMSM {
+  double Ld = 375e-6;    // d-axis inductance
+  double Lq = 435e-6;    // q-axis inductance
+  double Rs = 0.56;      // stator resistance
+  double psi_r = 0.0143; // rotor flux
+  double np = 2;         // pole pairs
+  double J = 0.12e-4;    // inertia
+
+  void fx(double, const VectorXd &x, const VectorXd &u,
+          VectorXd &xdot) const {
+    double id = x(0);
+    double iq = x(1);
+    double omega = x(2);
+
+    xdot << 1 / Ld * (u(0) - Rs * id + np * omega * Lq * iq),
+        1 / Lq * (u(1) - Rs * iq - np * omega * (Ld * id + psi_r)),
+        1 / J * (3 * np / 2 * (psi_r * iq + (Ld - Lq) * id * iq) - u(2));
+  }
+};
+/* ---------------------------------------------------- */
+
+/* ---------------------------------------------------- */
+/* RungeKutta::step, ns per step */
+/* ---------------------------------------------------- */
+// 1e5 steps per iteration through solve with a sink that drops the samples,
+// the step counter reports the time of one step
+template <typename Solver, typename State>
+static void steps(benchmark::State &state, Solver &rk, const State &x0) {
+  const double n_steps = 1e5;
+  AllocationCounter allocs(state);
+  for (auto _ : state) {
+    rk.solve(0.0, 0.1, x0, 0.1 / n_steps,
+             [](double, const auto &x) { benchmark::DoNotOptimize(x); });
+  }
+  state.counters["step"] = benchmark::Counter(
+      n_steps, benchmark::Counter::kIsIterationInvariantRate |
+                   benchmark::Counter::kInvert);
+}
+
+// Dynamic state size through the virtual SimulationModel interface
+static void BM_RungeKuttaStep(benchmark::State &state) {
+  const PMSMOpenLoop pmsm;
+  const FixedStepSimulators::SimulationModel &model = pmsm;
+  FixedStepSimulators::RungeKutta rk(model);
+  steps(state, rk, VectorXd::Zero(3));
+}
+BENCHMARK(BM_RungeKuttaStep);
+
+// Fixed state size, model called directly
+static void BM_RungeKuttaStepFixed(benchmark::State &state) {
+  const PMSMOpenLoop pmsm;
+  FixedStepSimulators::RungeKutta<PMSMOpenLoop, 3> rk(pmsm);
+  steps(state, rk, Vector3d::Zero());
+}
+BENCHMARK(BM_RungeKuttaStepFixed);
+/* ---------------------------------------------------- */
+
+/* ---------------------------------------------------- */
+/* Closed-loop PMSM, controller per stage vs sampled at Tctrl */
+/* ---------------------------------------------------- */
+static void BM_ClosedLoopStep(benchmark::State &state) {
+  const PMSM pmsm;
+  FixedStepSimulators::RungeKutta<PMSM, 6> rk(pmsm);
+  steps(state, rk, PMSM::State::Zero());
+}
+BENCHMARK(BM_ClosedLoopStep);
+
+static void BM_ClosedLoopSampledStep(benchmark::State &state) {
+  PMSMOpenLoop plant;
+  PMSMController ctrl(plant);
+  FixedStepSimulators::RungeKutta<PMSMOpenLoop, 3> rk(plant);
+  const double n_steps = 1e5;
+  AllocationCounter allocs(state);
+  for (auto _ : state) {
+    ctrl.reset();
+    rk.solve(
+        0.0, 0.1, Vector3d::Zero(), 0.1 / n_steps,
+        [](double, const auto &x) { benchmark::DoNotOptimize(x); },
+        ctrl.c.Tctrl, ctrl);
+  }
+  state.counters["step"] = benchmark::Counter(
+      n_steps, benchmark::Counter::kIsIterationInvariantRate |
+                   benchmark::Counter::kInvert);
+}
+BENCHMARK(BM_ClosedLoopSampledStep);
+
+// stiff solver at the same dt, per-step cost including the Jacobian and LU
+static void BM_ClosedLoopRosenbrockStep(benchmark::State &state) {
+  const PMSM pmsm;
+  ImplicitSimulators::Rosenbrock<PMSM, 6> ros(pmsm, state.range(0));
+  steps(state, ros, PMSM::State::Zero());
+}
+BENCHMARK(BM_ClosedLoopRosenbrockStep)->Arg(1)->Arg(10)->Arg(100);
+/* ---------------------------------------------------- */
+
+/* ---------------------------------------------------- */
+/* RungeKutta::solve throughput vs number of samples */
+/* ---------------------------------------------------- */
+static void BM_RungeKuttaSolve(benchmark::State &state) {
+  const PMSMOpenLoop pmsm;
+  FixedStepSimulators::RungeKutta<PMSMOpenLoop, 3> rk(pmsm);
+  double dt = 1.0 / static_cast<double>(state.range(0));
+  AllocationCounter allocs(state);
+  for (auto _ : state) {
+    auto [ts, xs] = rk.solve(0.0, 1.0, Vector3d::Zero(), dt);
+    benchmark::DoNotOptimize(xs.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_RungeKuttaSolve)
+    ->RangeMultiplier(10)
+    ->Range(1000, 1000000)
+    ->Unit(benchmark::kMillisecond);
+/* ---------------------------------------------------- */
+
+/* ---------------------------------------------------- */
+/* simple_simulation integrators vs number of samples */
+/* ---------------------------------------------------- */
+template <typename Integrator>
+static void simple_simulation(benchmark::State &state, Integrator integrate) {
+  SimplePMSM pmsm;
+  Index N = state.range(0);
+  VectorXd t = VectorXd::LinSpaced(N, 0.0, 1.0);
+  MatrixXd u = MatrixXd::Zero(3, N);
+  u.row(1).setConstant(6.0);
+  MatrixXd x = MatrixXd::Zero(3, N);
+  AllocationCounter allocs(state);
+  for (auto _ : state) {
+    integrate(t, x, u, pmsm);
+    benchmark::DoNotOptimize(x.data());
+  }
+  state.SetItemsProcessed(state.iterations() * N);
+}
+
+static void BM_SimpleRungeKutta4(benchmark::State &state) {
+  simple_simulation(state, FixedStepSimulators::RungeKutta4<SimplePMSM>);
+}
+BENCHMARK(BM_SimpleRungeKutta4)
+    ->RangeMultiplier(10)
+    ->Range(1000, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_SimpleEulerForward(benchmark::State &state) {
+  simple_simulation(state, FixedStepSimulators::euler_forward<SimplePMSM>);
+}
+BENCHMARK(BM_SimpleEulerForward)
+    ->RangeMultiplier(10)
+    ->Range(1000, 1000000)
+    ->Unit(benchmark::kMillisecond);
+/* ---------------------------------------------------- */
+
+/* ---------------------------------------------------- */
+/* Export cost of an N-sample, 3-state trajectory */
+/* ---------------------------------------------------- */
+static const std::string export_file = "/tmp/pmsm_benchmark";
+
+// The writers print "saved to ..." on close, keep it out of the report
+class QuietCout {
+public:
+  QuietCout() : buf(std::cout.rdbuf(nullptr)) {}
+  ~QuietCout() { std::cout.rdbuf(buf); }
+
+private:
+  std::streambuf *buf;
+};
+
+// channel name x0, x1, ..., appended in place (GCC 12 -Wrestrict on "x" + s)
+static std::string channel(Index i) {
+  std::string key = "x";
+  key += std::to_string(i);
+  return key;
+}
+
+static void BM_ExportNlohmannJson(benchmark::State &state) {
+  Index N = state.range(0);
+  VectorXd ts = VectorXd::LinSpaced(N, 0.0, 1.0);
+  MatrixXd xs = MatrixXd::Random(3, N);
+  QuietCout quiet;
+  AllocationCounter allocs(state);
+  for (auto _ : state) {
+    nljson json_obj;
+    json_obj["t"] = std::vector<double>(ts.begin(), ts.end());
+    for (Index i = 0; i < xs.rows(); ++i) {
+      json_obj[channel(i)] =
+          std::vector<double>(xs.row(i).begin(), xs.row(i).end());
+    }
+    create_jsonfile(export_file, json_obj);
+  }
+  state.SetBytesProcessed(state.iterations() * N * 4 * sizeof(double));
+}
+
+static void BM_ExportJsonWriter(benchmark::State &state) {
+  Index N = state.range(0);
+  VectorXd ts = VectorXd::LinSpaced(N, 0.0, 1.0);
+  MatrixXd xs = MatrixXd::Random(3, N);
+  QuietCout quiet;
+  AllocationCounter allocs(state);
+  for (auto _ : state) {
+    JsonWriter json(export_file);
+    json.begin_object();
+    json.field("t", ts);
+    for (Index i = 0; i < xs.rows(); ++i) {
+      json.field(channel(i), xs.row(i));
+    }
+    json.end_object();
+  }
+  state.SetBytesProcessed(state.iterations() * N * 4 * sizeof(double));
+}
+
+static void BM_ExportNpz(benchmark::State &state) {
+  Index N = state.range(0);
+  VectorXd ts = VectorXd::LinSpaced(N, 0.0, 1.0);
+  MatrixXd xs = MatrixXd::Random(3, N);
+  QuietCout quiet;
+  AllocationCounter allocs(state);
+  for (auto _ : state) {
+    NpzWriter npz(export_file);
+    npz.write("t", ts);
+    for (Index i = 0; i < xs.rows(); ++i) {
+      npz.write(channel(i), xs.row(i));
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * N * 4 * sizeof(double));
+}
+/* ---------------------------------------------------- */
+
+#define EXPORT_BENCHMARK(name)                                                 \
+  BENCHMARK(name)                                                              \
+      ->RangeMultiplier(10)                                                    \
+      ->Range(1000, 1000000)                                                   \
+      ->Unit(benchmark::kMillisecond)
+
+EXPORT_BENCHMARK(BM_ExportNlohmannJson);
+EXPORT_BENCHMARK(BM_ExportJsonWriter);
+EXPORT_BENCHMARK(BM_ExportNpz);
+
+BENCHMARK_MAIN();
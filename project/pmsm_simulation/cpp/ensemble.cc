@@ -0,0 +1,73 @@
+#include <cmath>
+#include <eigen3/Eigen/Dense>
+#include <fmt/core.h>
+#include <vector>
+
+#include "ensemble_simulators.h" // Ensemble simulators
+#include "pmsm_models.h"         // PMSM parameters and ensemble model
+#include "timer.h"               // Timer class
+
+using namespace Eigen;
+
+/* Simulate the sweep in Scalar precision, returns the final ensemble state */
+template <typename Scalar>
+FixedStepSimulators::EnsembleState<3, Scalar>
+simulate(const std::vector<PMSMParameters> &params, double t0, double T,
+         double dt) {
+  using Ensemble = BasicPMSMEnsemble<Scalar>;
+  using State = FixedStepSimulators::EnsembleState<3, Scalar>;
+
+  // create ensemble and solver
+  const Ensemble pmsm(params);
+  FixedStepSimulators::EnsembleRungeKutta<Ensemble, 3, Scalar> rk(pmsm);
+  State X0 = State::Zero(3, pmsm.m);
+
+  Timer timer;
+  timer.tic();                       // start timer
+  State X = rk.solve(t0, T, X0, dt); // simulate
+  timer.toc();                       // stop timer
+
+  fmt::print("{}: simulated {} members x {} steps in {} ms ({:.1f} us per "
+             "member)\n",
+             sizeof(Scalar) == 4 ? "float32" : "float64", pmsm.m,
+             std::ceil((T - t0) / dt), timer.elapsed(),
+             1e3 * timer.elapsed() / pmsm.m);
+  return X;
+}
+
+/*! Main function */
+int main() {
+
+  // user defined parameters
+  double t0 = 0.0;  // start time
+  double T = 1.0;   // end time
+  double dt = 1E-6; // time step
+
+  // parameter sweep, +-20 % in Rs and J around the nominal motor
+  const int n_Rs = 16;
+  const int n_J = 16;
+  std::vector<PMSMParameters> params;
+  for (int i = 0; i < n_Rs; ++i) {
+    for (int j = 0; j < n_J; ++j) {
+      PMSMParameters p;
+      p.Rs *= 0.8 + 0.4 * i / (n_Rs - 1);
+      p.J *= 0.8 + 0.4 * j / (n_J - 1);
+      params.push_back(p);
+    }
+  }
+
+  // double reference, then single precision with twice the members per
+  // SIMD register
+  auto X = simulate<double>(params, t0, T, dt);
+  auto X_f = simulate<float>(params, t0, T, dt);
+
+  // summary of the final speed over the ensemble
+  fmt::print("final speed: min {:.2f}, mean {:.2f}, max {:.2f} rad/s\n",
+             X.row(2).minCoeff(), X.row(2).mean(), X.row(2).maxCoeff());
+  double err = ((X_f.row(2).cast<double>() - X.row(2)).array().abs() /
+                X.row(2).array().abs())
+                   .maxCoeff();
+  fmt::print("float32 final speed: max rel. difference {:.1e}\n", err);
+
+  return 0;
+}
@@ -0,0 +1,299 @@
+#ifndef ADAPTIVE_SIMULATORS_H
+#define ADAPTIVE_SIMULATORS_H
+
+#include <algorithm>
+#include <cmath>
+#include <eigen3/Eigen/Dense>
+#include <limits>
+#include <stdexcept>
+
+#include "events.h"     // Events
+#include "simulators.h" // SimulationModel
+
+using namespace Eigen;
+
+namespace AdaptiveStepSimulators {
+/*! Adaptive step-size simulators */
+
+using FixedStepSimulators::Events;
+using FixedStepSimulators::SimulationModel;
+
+/* Dormand-Prince 5(4) method
+ *
+ * Embedded 5th/4th order pair with FSAL (the last stage of a step is the
+ * first stage of the next, 6 model calls per accepted step) and the 4th
+ * order dense output of Hairer & Wanner, used to write the solution onto a
+ * user-requested output grid independently of the internal steps.
+ *
+ * Model and N are as for FixedStepSimulators::RungeKutta.
+ */
+template <typename Model = SimulationModel, int N = Dynamic>
+class DormandPrince {
+public:
+  using State = Matrix<double, N, 1>;
+  using Trajectory = Matrix<double, N, Dynamic>;
+
+  explicit DormandPrince(const Model &model, double rtol = 1e-6,
+                         double atol = 1e-9)
+      : rtol(rtol), atol(atol), x(dim(model)), model(model), k1(dim(model)),
+        k2(dim(model)), k3(dim(model)), k4(dim(model)), k5(dim(model)),
+        k6(dim(model)), k7(dim(model)), x_new(dim(model)), tmp(dim(model)),
+        r1(dim(model)), r2(dim(model)), r3(dim(model)), r4(dim(model)),
+        r5(dim(model)) {}
+
+  /* Simulate over the output grid ts (increasing, ts(0) is the start time)
+   * and return the states at the grid points */
+  auto solve(const VectorXd &ts, const State &x0) -> Trajectory {
+    Trajectory xs = Trajectory::Zero(x.size(), ts.size());
+    Index i = 0;
+    solve(ts, x0, [&](double, const State &x_i) { xs.col(i++) = x_i; });
+    return xs;
+  }
+
+  /* Simulate over the output grid ts and hand every grid sample to
+   * sink(t, x), see sinks.h */
+  template <typename Sink>
+  void solve(const VectorXd &ts, const State &x0, Sink &&sink) {
+    integrate(ts, x0, sink, nullptr);
+  }
+
+  /* Simulate with time events and zero crossings, see events.h. Steps end
+   * on every event and restart from a fresh f(t, x) and initial step. */
+  template <typename Sink>
+  void solve(const VectorXd &ts, const State &x0, Sink &&sink,
+             Events<N> &events) {
+    integrate(ts, x0, sink, &events);
+  }
+
+  double rtol;                                       // relative tolerance
+  double atol;                                       // absolute tolerance
+  double h_max{std::numeric_limits<double>::max()};  // largest step
+  double h_min{1e-14};                               // smallest step
+
+  // statistics of the last solve
+  size_t n_steps{0};    // accepted steps
+  size_t n_rejected{0}; // rejected steps
+  size_t n_rhs{0};      // model evaluations
+
+private:
+  // adaptive loop, events may be null
+  template <typename Sink>
+  void integrate(const VectorXd &ts, const State &x0, Sink &&sink,
+                 Events<N> *events) {
+    if (ts.size() == 0)
+      return;
+
+    t = ts(0);
+    x = x0;
+    n_steps = n_rejected = n_rhs = 0;
+    if (events)
+      events->start(t, x);
+    sink(t, x);
+
+    const double T = ts(ts.size() - 1);
+    model(t, x, k1);
+    ++n_rhs;
+    double h = std::min(initial_step(T - t), h_max);
+
+    Index i_out = 1;
+    while (i_out < ts.size()) {
+      const bool last = t + h >= T;
+      if (last)
+        h = T - t; // land exactly on the last grid point
+      const double t_e = events ? events->next_time()
+                                : std::numeric_limits<double>::infinity();
+      const bool hit = t + h >= t_e;
+      if (hit)
+        h = t_e - t; // land exactly on the time event
+      if (h < h_min)
+        throw std::runtime_error("DormandPrince: step size below h_min");
+
+      double err = attempt(h);
+      if (err > 1.0) { // reject and retry with a smaller step
+        h *= std::max(0.2, 0.9 * std::pow(err, -0.2));
+        ++n_rejected;
+        continue;
+      }
+
+      // t + (T - t) may round 1 ulp short of T, take the end points as is
+      double t_new = hit ? t_e : last ? T : t + h;
+
+      // earliest zero crossing inside the step, from the dense output
+      bool prepared = false;
+      int k = -1;
+      if (events && events->has_crossings()) {
+        prepare_dense_output(h);
+        prepared = true;
+        double t_c;
+        k = events->locate(
+            t, t_new, x_new,
+            [&](double t_s) -> const State & {
+              dense_output((t_s - t) / h, tmp);
+              return tmp;
+            },
+            t_c);
+        if (k >= 0) {
+          t_new = t_c;
+          dense_output((t_c - t) / h, x_new);
+        }
+      }
+
+      // write every grid point inside (t, t_new] from the dense output
+      if (!prepared && i_out < ts.size() && ts(i_out) <= t_new)
+        prepare_dense_output(h);
+      while (i_out < ts.size() && ts(i_out) <= t_new) {
+        if (ts(i_out) == t_new) {
+          sink(ts(i_out), x_new);
+        } else {
+          dense_output((ts(i_out) - t) / h, tmp);
+          sink(ts(i_out), tmp);
+        }
+        ++i_out;
+      }
+
+      // accept, FSAL: k7 = f(t + h, x_new) is the next k1
+      t = t_new;
+      x = x_new;
+      k1 = k7;
+      ++n_steps;
+
+      if (events && (k >= 0 || hit)) {
+        if (k >= 0)
+          events->fire_crossing(k, t, x);
+        else
+          events->fire_time(t, x);
+
+        // discontinuity, FSAL and the step size history are invalid
+        model(t, x, k1);
+        ++n_rhs;
+        h = std::min(initial_step(T - t), h_max);
+        continue;
+      }
+      if (events)
+        events->accept();
+
+      double fac = err == 0.0 ? 10.0 : 0.9 * std::pow(err, -0.2);
+      h = std::min(h * std::clamp(fac, 0.2, 10.0), h_max);
+    }
+  }
+  // Butcher tableau
+  static constexpr double c2 = 1.0 / 5, c3 = 3.0 / 10, c4 = 4.0 / 5,
+                          c5 = 8.0 / 9;
+  static constexpr double a21 = 1.0 / 5;
+  static constexpr double a31 = 3.0 / 40, a32 = 9.0 / 40;
+  static constexpr double a41 = 44.0 / 45, a42 = -56.0 / 15, a43 = 32.0 / 9;
+  static constexpr double a51 = 19372.0 / 6561, a52 = -25360.0 / 2187,
+                          a53 = 64448.0 / 6561, a54 = -212.0 / 729;
+  static constexpr double a61 = 9017.0 / 3168, a62 = -355.0 / 33,
+                          a63 = 46732.0 / 5247, a64 = 49.0 / 176,
+                          a65 = -5103.0 / 18656;
+  static constexpr double a71 = 35.0 / 384, a73 = 500.0 / 1113,
+                          a74 = 125.0 / 192, a75 = -2187.0 / 6784,
+                          a76 = 11.0 / 84;
+  // error estimate, difference of the 5th and 4th order weights
+  static constexpr double e1 = 71.0 / 57600, e3 = -71.0 / 16695,
+                          e4 = 71.0 / 1920, e5 = -17253.0 / 339200,
+                          e6 = 22.0 / 525, e7 = -1.0 / 40;
+  // dense output
+  static constexpr double d1 = -12715105075.0 / 11282082432,
+                          d3 = 87487479700.0 / 32700410799,
+                          d4 = -10690763975.0 / 1880347072,
+                          d5 = 701980252875.0 / 199316789632,
+                          d6 = -1453857185.0 / 822651844,
+                          d7 = 69997945.0 / 29380423;
+
+  // one step of size h from (t, x) with k1 = f(t, x), returns the scaled
+  // error norm, x_new and k7 = f(t + h, x_new)
+  double attempt(double h) {
+    tmp.noalias() = x + h * a21 * k1;
+    model(t + c2 * h, tmp, k2);
+    tmp.noalias() = x + h * (a31 * k1 + a32 * k2);
+    model(t + c3 * h, tmp, k3);
+    tmp.noalias() = x + h * (a41 * k1 + a42 * k2 + a43 * k3);
+    model(t + c4 * h, tmp, k4);
+    tmp.noalias() = x + h * (a51 * k1 + a52 * k2 + a53 * k3 + a54 * k4);
+    model(t + c5 * h, tmp, k5);
+    tmp.noalias() =
+        x + h * (a61 * k1 + a62 * k2 + a63 * k3 + a64 * k4 + a65 * k5);
+    model(t + h, tmp, k6);
+    x_new.noalias() =
+        x + h * (a71 * k1 + a73 * k3 + a74 * k4 + a75 * k5 + a76 * k6);
+    model(t + h, x_new, k7);
+    n_rhs += 6;
+
+    tmp.noalias() =
+        h * (e1 * k1 + e3 * k3 + e4 * k4 + e5 * k5 + e6 * k6 + e7 * k7);
+    double sum = 0.0;
+    for (Index i = 0; i < x.size(); ++i) {
+      double sc = atol + rtol * std::max(std::abs(x(i)), std::abs(x_new(i)));
+      sum += (tmp(i) / sc) * (tmp(i) / sc);
+    }
+    return std::sqrt(sum / x.size());
+  }
+
+  // Hairer's starting step size, uses k1 = f(t, x) and one model call
+  double initial_step(double span) {
+    double d0 = 0.0, d1_ = 0.0;
+    for (Index i = 0; i < x.size(); ++i) {
+      double sc = atol + rtol * std::abs(x(i));
+      d0 += (x(i) / sc) * (x(i) / sc);
+      d1_ += (k1(i) / sc) * (k1(i) / sc);
+    }
+    d0 = std::sqrt(d0 / x.size());
+    d1_ = std::sqrt(d1_ / x.size());
+    double h0 = (d0 < 1e-5 || d1_ < 1e-5) ? 1e-6 : 0.01 * d0 / d1_;
+    h0 = std::min(h0, span);
+
+    tmp.noalias() = x + h0 * k1;
+    model(t + h0, tmp, k2);
+    ++n_rhs;
+    double d2 = 0.0;
+    for (Index i = 0; i < x.size(); ++i) {
+      double sc = atol + rtol * std::abs(x(i));
+      d2 += ((k2(i) - k1(i)) / sc) * ((k2(i) - k1(i)) / sc);
+    }
+    d2 = std::sqrt(d2 / x.size()) / h0;
+
+    double dmax = std::max(d1_, d2);
+    double h1 = dmax <= 1e-15 ? std::max(1e-6, h0 * 1e-3)
+                              : std::pow(0.01 / dmax, 0.2);
+    return std::min({100 * h0, h1, span});
+  }
+
+  // interpolation coefficients of the last successful attempt
+  void prepare_dense_output(double h) {
+    r1 = x;
+    r2 = x_new - x;
+    r3 = h * k1 - r2;
+    r4 = r2 - h * k7 - r3;
+    r5 = h * (d1 * k1 + d3 * k3 + d4 * k4 + d5 * k5 + d6 * k6 + d7 * k7);
+  }
+
+  // state at t + theta * h, 0 <= theta <= 1
+  void dense_output(double theta, State &out) const {
+    double theta1 = 1.0 - theta;
+    out = r1 + theta * (r2 + theta1 * (r3 + theta * (r4 + theta1 * r5)));
+  }
+
+  // state dimension, taken from the model only for dynamic-size states
+  static Index dim(const Model &model) {
+    if constexpr (N == Dynamic)
+      return static_cast<Index>(model.n);
+    else
+      return N;
+  }
+
+  State x;
+  double t{0.0};
+
+  const Model &model;
+
+  State k1, k2, k3, k4, k5, k6, k7;
+  State x_new;
+  State tmp;
+  State r1, r2, r3, r4, r5; // dense output coefficients
+};
+
+} // namespace AdaptiveStepSimulators
+
+#endif // ADAPTIVE_SIMULATORS_H
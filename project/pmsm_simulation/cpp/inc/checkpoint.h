@@ -0,0 +1,170 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <eigen3/Eigen/Dense>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace Eigen;
+
+namespace FixedStepSimulators {
+/*! Solver checkpoints for restart and warm start
+ *
+ * RungeKutta is a one-step method, so (t, x) at a sample plus the sample grid
+ * (t0, dt, index) is the complete solver state. A run resumed from a
+ * checkpoint continues on the same grid, with controller ticks on the same
+ * samples, and reproduces the uninterrupted run. States that live outside
+ * the solver, such as a sampled controller's integrators or held inputs, go
+ * into `extra`.
+ *
+ * Example: auto ck = rk.checkpoint();   // after a spin-up solve
+ *          ck.save("spin_up.ckpt");
+ *          rk.resume(Checkpoint<6>::load("spin_up.ckpt"), T, sink);
+ */
+template <int N = Dynamic> struct Checkpoint {
+  using State = Matrix<double, N, 1>;
+
+  double t0{0.0};            // start of the sample grid
+  double dt{0.0};            // time step
+  uint64_t index{0};         // sample index, t ~ t0 + index * dt
+  double t{0.0};             // time of the sample
+  double t_comp{0.0};        // compensation of the time sum
+  State x;                   // state at t, double for any solver Scalar
+  std::vector<double> extra; // states outside the solver
+
+  /* Write to path, through a temporary file and a rename, so a crash while
+   * writing leaves the previous checkpoint intact */
+  void save(const std::string &path) const {
+    const std::string tmp = path + ".tmp";
+    {
+      std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+      if (!out)
+        throw std::runtime_error("Checkpoint: cannot open " + tmp);
+      const uint64_t n = static_cast<uint64_t>(x.size());
+      const uint64_t n_extra = extra.size();
+      out.write(magic, sizeof(magic));
+      write(out, version);
+      write(out, t0);
+      write(out, dt);
+      write(out, index);
+      write(out, t);
+      write(out, t_comp);
+      write(out, n);
+      out.write(reinterpret_cast<const char *>(x.data()), n * sizeof(double));
+      write(out, n_extra);
+      out.write(reinterpret_cast<const char *>(extra.data()),
+                n_extra * sizeof(double));
+      if (!out.flush())
+        throw std::runtime_error("Checkpoint: cannot write " + tmp);
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0)
+      throw std::runtime_error("Checkpoint: cannot rename " + tmp + " to " +
+                               path);
+  }
+
+  /* Read a checkpoint written by save */
+  static Checkpoint load(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+      throw std::runtime_error("Checkpoint: cannot open " + path);
+    char tag[sizeof(magic)];
+    in.read(tag, sizeof(tag));
+    if (!in || std::memcmp(tag, magic, sizeof(magic)) != 0)
+      throw std::runtime_error("Checkpoint: " + path + " is not a checkpoint");
+    Checkpoint ck;
+    uint32_t file_version = 0;
+    uint64_t n = 0, n_extra = 0;
+    read(in, file_version);
+    if (file_version != version)
+      throw std::runtime_error("Checkpoint: unsupported version in " + path);
+    read(in, ck.t0);
+    read(in, ck.dt);
+    read(in, ck.index);
+    read(in, ck.t);
+    read(in, ck.t_comp);
+    read(in, n);
+    if (!in || (N != Dynamic && n != static_cast<uint64_t>(N)))
+      throw std::runtime_error("Checkpoint: state size mismatch in " + path);
+    ck.x.resize(static_cast<Index>(n));
+    in.read(reinterpret_cast<char *>(ck.x.data()), n * sizeof(double));
+    read(in, n_extra);
+    if (!in)
+      throw std::runtime_error("Checkpoint: " + path + " is truncated");
+    ck.extra.resize(n_extra);
+    in.read(reinterpret_cast<char *>(ck.extra.data()),
+            n_extra * sizeof(double));
+    if (!in)
+      throw std::runtime_error("Checkpoint: " + path + " is truncated");
+    return ck;
+  }
+
+private:
+  static constexpr char magic[8] = {'S', 'I', 'M', 'C', 'K', 'P', 'T', '\0'};
+  static constexpr uint32_t version = 2;
+
+  template <typename T> static void write(std::ofstream &out, const T &v) {
+    out.write(reinterpret_cast<const char *>(&v), sizeof(T));
+  }
+  template <typename T> static void read(std::ifstream &in, T &v) {
+    in.read(reinterpret_cast<char *>(&v), sizeof(T));
+  }
+};
+
+/* Sink that saves the solver's checkpoint every `every` samples, for long
+ * runs that should survive a crash. save_extra(extra) fills the states
+ * outside the solver. For hybrid runs pick `every` as a multiple of Tctrl /
+ * dt, the checkpoint is then taken just before a controller tick. The
+ * starting sample of a solve or resume is not saved again.
+ *
+ * Example: CheckpointSink ck(rk, "run.ckpt", 1000000);
+ *          rk.solve(t0, T, x0, dt, [&](double t, const auto &x) {
+ *            store(t, x);
+ *            ck(t, x);
+ *          });
+ */
+template <typename Solver> class CheckpointSink {
+public:
+  using Extra = std::function<void(std::vector<double> &)>;
+
+  CheckpointSink(const Solver &solver, std::string path, size_t every,
+                 Extra save_extra = {})
+      : path(std::move(path)), every(every), solver(solver),
+        save_extra(std::move(save_extra)) {
+    if (every == 0)
+      throw std::invalid_argument("CheckpointSink: every must be positive");
+  }
+
+  template <typename State> void operator()(double, const State &) {
+    if (first) {
+      first = false;
+      return;
+    }
+    if (solver.sample_index() % every != 0)
+      return;
+    auto ck = solver.checkpoint();
+    if (save_extra)
+      save_extra(ck.extra);
+    ck.save(path);
+    ++n_saved;
+  }
+
+  std::string path;
+  size_t every;
+  size_t n_saved{0}; // checkpoints written
+
+private:
+  const Solver &solver;
+  Extra save_extra;
+  bool first{true};
+};
+
+} // namespace FixedStepSimulators
+
+#endif // CHECKPOINT_H
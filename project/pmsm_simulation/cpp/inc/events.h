@@ -0,0 +1,190 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <algorithm>
+#include <cmath>
+#include <eigen3/Eigen/Dense>
+#include <functional>
+#include <limits>
+#include <vector>
+
+using namespace Eigen;
+
+namespace FixedStepSimulators {
+/*! Discontinuity events for RungeKutta and DormandPrince
+ *
+ * Time events at(t_e, action) end a step exactly at t_e. Zero crossings
+ * when(g, action) are detected by a sign change of g(t, x) over a step and
+ * located with the Illinois method. In both cases the solver then calls
+ * action(t, x), which may change the state or the model's inputs, and
+ * integration restarts from there, so no step straddles a discontinuity.
+ *
+ * N and Scalar are those of the solver's state.
+ *
+ * Example: Events<3> events;
+ *          events.at(0.5, [&](double, Vector3d &) { pmsm.Tl = 0.08; });
+ *          rk.solve(t0, T, x0, dt, sink, events);
+ */
+template <int N = Dynamic, typename Scalar = double> class Events {
+public:
+  using State = Matrix<Scalar, N, 1>;
+  using Action = std::function<void(double, State &)>;
+  using Guard = std::function<double(double, const State &)>;
+
+  /* Time event, action(t_e, x) runs at t_e */
+  void at(double t_e, Action action) {
+    auto pos = std::upper_bound(
+        times.begin(), times.end(), t_e,
+        [](double t, const TimeEvent &e) { return t < e.t; });
+    times.insert(pos, {t_e, std::move(action)});
+  }
+
+  /* Zero crossing of g(t, x). direction +1 fires on rising crossings only,
+   * -1 on falling crossings only, 0 on both */
+  void when(Guard g, Action action, int direction = 0) {
+    crossings.push_back({std::move(g), std::move(action), direction});
+  }
+
+  double t_tol{1e-12}; // crossing time tolerance, relative to max(1, |t|)
+  size_t n_fired{0};   // events fired in the last solve
+
+  /* Solver side */
+
+  // before the first sample: fire time events at or before t0 and evaluate
+  // the crossing functions
+  void start(double t0, State &x) {
+    i_next = 0;
+    n_fired = 0;
+    while (i_next < times.size() && times[i_next].t <= t0) {
+      times[i_next++].action(t0, x);
+      ++n_fired;
+    }
+    for (Crossing &c : crossings)
+      c.g_prev = c.g(t0, x);
+  }
+
+  // time of the next pending time event, infinity if there is none
+  double next_time() const {
+    return i_next < times.size() ? times[i_next].t
+                                 : std::numeric_limits<double>::infinity();
+  }
+
+  bool has_crossings() const { return !crossings.empty(); }
+
+  // Checks the crossing functions at the end of a step from t_a to
+  // (t_b, x_b). Returns the index of the earliest crossing, -1 for none, and
+  // its time in t_c, the first time found past the root. state_at(t) must
+  // return the state at any t in [t_a, t_b].
+  template <typename StateAt>
+  int locate(double t_a, double t_b, const State &x_b, StateAt &&state_at,
+             double &t_c) {
+    int k_first = -1;
+    t_c = t_b;
+    for (size_t k = 0; k < crossings.size(); ++k) {
+      Crossing &c = crossings[k];
+      c.g_new = c.g(t_b, x_b);
+      if (!crossed(c, c.g_new))
+        continue;
+      double t_k = root(c, t_a, t_b, state_at);
+      if (k_first < 0 || t_k < t_c) {
+        k_first = static_cast<int>(k);
+        t_c = t_k;
+      }
+    }
+    return k_first;
+  }
+
+  // no crossing in the last step
+  void accept() {
+    for (Crossing &c : crossings)
+      c.g_prev = c.g_new;
+  }
+
+  // crossing k was located at (t, x)
+  void fire_crossing(int k, double t, State &x) {
+    crossings[k].action(t, x);
+    ++n_fired;
+    restart(t, x);
+    crossings[k].g_prev = 0.0; // at the root, wait for g to leave zero
+  }
+
+  // the step ended on next_time()
+  void fire_time(double t, State &x) {
+    while (i_next < times.size() && times[i_next].t <= t) {
+      times[i_next++].action(t, x);
+      ++n_fired;
+    }
+    restart(t, x);
+  }
+
+private:
+  struct TimeEvent {
+    double t;
+    Action action;
+  };
+  struct Crossing {
+    Guard g;
+    Action action;
+    int direction;
+    double g_prev{0.0};
+    double g_new{0.0};
+  };
+
+  bool crossed(const Crossing &c, double g) const {
+    bool rising = c.g_prev < 0.0 && g >= 0.0;
+    bool falling = c.g_prev > 0.0 && g <= 0.0;
+    return (rising && c.direction >= 0) || (falling && c.direction <= 0);
+  }
+
+  // Illinois (modified regula falsi) on [t_a, t_b], keeps the bracket and
+  // returns its right end, where g is already on the far side of zero. The
+  // side is decided against g_a, which is never zero for a crossing; g_b is
+  // exactly zero when the guard vanishes on the step's end, e.g. time-linear
+  // guards on a regular grid
+  template <typename StateAt>
+  double root(const Crossing &c, double t_a, double t_b, StateAt &state_at) {
+    double g_a = c.g_prev;
+    double g_b = c.g_new;
+    if (g_b == 0.0)
+      return t_b;
+    int side = 0;
+    for (int it = 0; it < 100; ++it) {
+      if (t_b - t_a <= t_tol * std::max(1.0, std::abs(t_b)))
+        break;
+      double t_m = (t_a * g_b - t_b * g_a) / (g_b - g_a);
+      if (!(t_m > t_a && t_m < t_b))
+        t_m = 0.5 * (t_a + t_b); // bracket too flat, bisect
+      double g_m = c.g(t_m, state_at(t_m));
+      if (g_m == 0.0 || (g_m > 0.0) != (g_a > 0.0)) {
+        t_b = t_m;
+        g_b = g_m;
+        if (g_m == 0.0)
+          break;
+        if (side == 1)
+          g_a *= 0.5;
+        side = 1;
+      } else {
+        t_a = t_m;
+        g_a = g_m;
+        if (side == -1)
+          g_b *= 0.5;
+        side = -1;
+      }
+    }
+    return t_b;
+  }
+
+  // the state may have jumped, start the sign tests from it
+  void restart(double t, const State &x) {
+    for (Crossing &c : crossings)
+      c.g_prev = c.g(t, x);
+  }
+
+  std::vector<TimeEvent> times; // sorted by time
+  size_t i_next{0};             // first time event not fired yet
+  std::vector<Crossing> crossings;
+};
+
+} // namespace FixedStepSimulators
+
+#endif // EVENTS_H
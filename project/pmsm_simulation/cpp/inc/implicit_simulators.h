@@ -0,0 +1,202 @@
+#ifndef IMPLICIT_SIMULATORS_H
+#define IMPLICIT_SIMULATORS_H
+
+#include <algorithm>
+#include <cmath>
+#include <concepts>
+#include <eigen3/Eigen/Dense>
+#include <limits>
+#include <numbers>
+#include <utility>
+
+#include "profiler.h"   // PROFILE_ZONE
+#include "simulators.h" // SimulationModel
+
+using namespace Eigen;
+
+namespace ImplicitSimulators {
+/*! Linearly implicit simulators for stiff models */
+
+using FixedStepSimulators::SimulationModel;
+
+/* Model with an analytic Jacobian, model.jacobian(t, x, J) fills J = df/dx
+ * and returns false to fall back to finite differences */
+template <typename Model, typename State, typename Jacobian>
+concept HasJacobian = requires(const Model &model, double t, const State &x,
+                               Jacobian &J) {
+  { model.jacobian(t, x, J) } -> std::convertible_to<bool>;
+};
+
+/* Two-stage Rosenbrock-W method ROS2 (Verwer et al. 1999)
+ *
+ *   (I - g dt J) k1 = f(t, x)
+ *   (I - g dt J) k2 = f(t + dt, x + dt k1) - 2 k1
+ *   x += dt (3/2 k1 + 1/2 k2),  g = 1 + 1/sqrt(2)
+ *
+ * L-stable and second order for any J, so the Jacobian and the LU
+ * factorization of I - g dt J are kept for jac_every steps (and refreshed
+ * when dt changes) at no loss of order; by default for default_jac_every
+ * steps, jac_every = 1 refreshes them on every step. Two model calls and two
+ * triangular solves per step, plus n model calls per finite-difference
+ * Jacobian.
+ *
+ * Model and N are as for FixedStepSimulators::RungeKutta. The Jacobian comes
+ * from model.jacobian(t, x, J) when the model has one (HasJacobian),
+ * otherwise from forward differences.
+ */
+template <typename Model = SimulationModel, int N = Dynamic> class Rosenbrock {
+public:
+  using State = Matrix<double, N, 1>;
+  using Trajectory = Matrix<double, N, Dynamic>;
+  using Jacobian = Matrix<double, N, N>;
+
+  static constexpr size_t default_jac_every = 10;
+
+  explicit Rosenbrock(const Model &model,
+                      size_t jac_every = default_jac_every)
+      : jac_every(jac_every), x(dim(model)), model(model), k1(dim(model)),
+        k2(dim(model)), f0(dim(model)), f1(dim(model)), tmp(dim(model)),
+        J(dim(model), dim(model)), W(dim(model), dim(model)),
+        lu(dim(model)) {}
+
+  void step(const double &dt) {
+    PROFILE_ZONE("Rosenbrock::step");
+    eval(t, x, f0);
+    if (n_since_jac == 0 || n_since_jac >= jac_every || dt != dt_lu)
+      factorize(dt);
+    ++n_since_jac;
+
+    k1.noalias() = lu.solve(f0);
+    tmp.noalias() = x + dt * k1;
+    eval(t + dt, tmp, f1);
+    f1 -= 2 * k1;
+    k2.noalias() = lu.solve(f1);
+
+    x += dt * (1.5 * k1 + 0.5 * k2);
+  }
+
+  /* Simulate from t0 to T and store the full trajectory */
+  auto solve(const double &t0, const double &T, const State &x0,
+             const double &dt) -> std::pair<VectorXd, Trajectory> {
+
+    size_t N_smp = n_samples(t0, T, dt);
+    VectorXd ts = VectorXd::Zero(N_smp);
+    Trajectory xs = Trajectory::Zero(x.size(), N_smp);
+
+    size_t i = 0;
+    solve(t0, T, x0, dt, [&](double t_i, const State &x_i) {
+      ts(i) = t_i;       // store time
+      xs.col(i++) = x_i; // store state
+    });
+
+    return {std::move(ts), std::move(xs)};
+  }
+
+  /* Simulate from t0 to T and hand every sample to sink(t, x), see
+   * sinks.h */
+  template <typename Sink>
+  void solve(const double &t0, const double &T, const State &x0, double dt,
+             Sink &&sink) {
+    PROFILE_ZONE("Rosenbrock::solve");
+
+    size_t N_smp = n_samples(t0, T, dt);
+
+    t = t0;
+    x = x0;
+    n_since_jac = 0; // new run, new Jacobian
+    n_rhs = n_jac = n_lu = 0;
+    for (size_t i = 0; i < N_smp; ++i) {
+      sink(t, x);
+
+      if (i + 1 == N_smp)
+        break; // last sample, no step past T
+
+      if ((t + dt) > T)
+        dt = T - t; // adjust time step
+
+      step(dt);
+      t += dt;
+    }
+  }
+
+  /* Number of samples solve produces, including both end points */
+  static size_t n_samples(const double &t0, const double &T,
+                          const double &dt) {
+    return std::ceil((T - t0) / dt) + 1;
+  }
+
+  size_t jac_every; // steps between Jacobian updates
+
+  // statistics of the last solve
+  size_t n_rhs{0}; // model evaluations, including finite differences
+  size_t n_jac{0}; // Jacobian evaluations
+  size_t n_lu{0};  // LU factorizations
+
+private:
+  static constexpr double gamma = 1.0 + 1.0 / std::numbers::sqrt2;
+
+  void eval(double t_s, const State &x_s, State &xdot) {
+    PROFILE_ZONE("Rosenbrock::model");
+    model(t_s, x_s, xdot);
+    ++n_rhs;
+  }
+
+  // J at (t, x), f0 = f(t, x) is already evaluated
+  void jacobian() {
+    PROFILE_ZONE("Rosenbrock::jacobian");
+    ++n_jac;
+    if constexpr (HasJacobian<Model, State, Jacobian>) {
+      if (model.jacobian(t, x, J))
+        return;
+    }
+
+    // forward differences, one model call per state
+    const double sqrt_eps = std::sqrt(std::numeric_limits<double>::epsilon());
+    tmp = x;
+    for (Index j = 0; j < x.size(); ++j) {
+      double dx = sqrt_eps * std::max(1.0, std::abs(x(j)));
+      tmp(j) = x(j) + dx;
+      eval(t, tmp, f1);
+      J.col(j) = (f1 - f0) / dx;
+      tmp(j) = x(j);
+    }
+  }
+
+  // new Jacobian and LU factorization of W = I - gamma dt J
+  void factorize(double dt) {
+    jacobian();
+    PROFILE_ZONE("Rosenbrock::lu");
+    W = -gamma * dt * J;
+    W.diagonal().array() += 1.0;
+    lu.compute(W);
+    ++n_lu;
+    dt_lu = dt;
+    n_since_jac = 0;
+  }
+
+  // state dimension, taken from the model only for dynamic-size states
+  static Index dim(const Model &model) {
+    if constexpr (N == Dynamic)
+      return static_cast<Index>(model.n);
+    else
+      return N;
+  }
+
+  State x;
+  double t{0.0};
+
+  const Model &model;
+
+  State k1, k2;
+  State f0, f1;
+  State tmp;
+  Jacobian J;
+  Jacobian W;
+  PartialPivLU<Jacobian> lu;
+  double dt_lu{0.0};     // step size of the current factorization
+  size_t n_since_jac{0}; // steps since the last factorization
+};
+
+} // namespace ImplicitSimulators
+
+#endif // IMPLICIT_SIMULATORS_H
@@ -0,0 +1,222 @@
+#ifndef PMSM_H
+#define PMSM_H
+
+#include <cmath>
+#include <eigen3/Eigen/Dense>
+#include <numbers>
+#include <stdexcept>
+#include <vector>
+
+#include "pmsm_models.h" // PMSMParameters
+#include "simulators.h"  // SimulationModel
+
+using namespace Eigen;
+
+/* ---------------------------------------------------- */
+/* Controller parameters, defaults are the ones in python/main.py */
+/* ---------------------------------------------------- */
+struct PMSMControllerParameters {
+  double tri_c = 1e-3; // current loop rise time
+  double tri_s = 1e-2; // speed loop rise time
+  double Tctrl = 2e-4; // controller sample time
+  double Ibase = 2;    // q-axis current reference limit
+  double Vbase = 12;   // voltage circle radius
+};
+/* ---------------------------------------------------- */
+
+/* ---------------------------------------------------- */
+/* Cascaded speed and current control law */
+/* ---------------------------------------------------- */
+// Speed PI with active damping Ba, clamped at Ibase, feeding d/q current PI
+// loops with decoupling, saturated on the voltage circle Vbase. Same
+// equations, in the same order, as controller in python/main.py. Shared by
+// the continuous PMSM model and the sampled PMSMController.
+class PMSMControlLaw {
+public:
+  struct Output {
+    double vd, vq;     // voltage references after saturation
+    double ed, eq, es; // integrator inputs, errors with anti-windup
+  };
+
+  explicit PMSMControlLaw(const PMSMParameters &p,
+                          const PMSMControllerParameters &c = {})
+      : p(p), c(c) {
+    tune();
+  }
+
+  /* Controller gains from the motor parameters and the rise times, call
+   * again after changing p or c */
+  void tune() {
+    alpha_c = std::log(9) / c.tri_c;
+    Kpd = alpha_c * p.Ld;
+    Kpq = alpha_c * p.Lq;
+    Kid = alpha_c * alpha_c * p.Ld;
+    Kiq = alpha_c * alpha_c * p.Lq;
+    Rad = alpha_c * p.Ld - p.Rs;
+    Raq = alpha_c * p.Lq - p.Rs;
+    alpha_s = std::log(9) / c.tri_s;
+    psi = 3 * p.np * p.psi_r / 2;
+    Kps = p.J * alpha_s / psi;
+    Kis = p.J * (alpha_s * alpha_s) / psi;
+    Ba = (alpha_s * p.J - p.b) / psi;
+  }
+
+  /* Control law at time t for the measured id, iq, w and the integrator
+   * states Id, Iq, Is */
+  Output control(double t, double id, double iq, double w, double Id,
+                 double Iq, double Is) const {
+    double w_ref_t = t < t_ref ? 0.0 : w_ref;
+
+    double id_ref = 0;
+    double iq_ref = (w_ref_t - w) * Kps + Is * Kis - Ba * w;
+
+    iq_ref =
+        std::abs(iq_ref) < c.Ibase ? iq_ref : std::copysign(c.Ibase, iq_ref);
+
+    double vd_ref =
+        (id_ref - id) * Kpd + Id * Kid - Rad * id - p.np * w * p.Lq * iq;
+    double vq_ref = (iq_ref - iq) * Kpq + Iq * Kiq - Raq * iq +
+                    p.np * w * (p.Ld * id + p.psi_r);
+
+    double vdq = std::sqrt(vd_ref * vd_ref + vq_ref * vq_ref);
+    double vd = vdq < c.Vbase ? vd_ref : vd_ref / vdq * c.Vbase;
+    double vq = vdq < c.Vbase ? vq_ref : vq_ref / vdq * c.Vbase;
+
+    return {vd, vq, (id_ref - id) + (1 / Kpd) * (vd - vd_ref),
+            (iq_ref - iq) + (1 / Kpq) * (vq - vq_ref),
+            (w_ref_t - w) + (1 / Kps) * (iq_ref - iq)};
+  }
+
+  PMSMParameters p;           // motor parameters
+  PMSMControllerParameters c; // controller parameters
+
+  // inputs
+  double w_ref{4000 * 2 * std::numbers::pi / 60}; // speed ref. after t_ref
+  double t_ref{0.1};                              // speed ref. step time
+
+  // controller gains, set by tune()
+  double alpha_c, Kpd, Kpq, Kid, Kiq, Rad, Raq;
+  double alpha_s, psi, Kps, Kis, Ba;
+};
+/* ---------------------------------------------------- */
+
+/* ---------------------------------------------------- */
+/* Closed-loop PMSM, controller evaluated on every stage */
+/* ---------------------------------------------------- */
+// x[0] -> id, x[1] -> iq, x[2] -> omega, x[3] -> Id, x[4] -> Iq, x[5] -> Is
+// where Id, Iq and Is are the integrator states of the d/q current and the
+// speed controllers. Inputs are a speed reference step at t_ref and a load
+// torque step at t_load. Same equations, in the same order, as pmsm_model
+// in python/main.py.
+class PMSM : public FixedStepSimulators::SimulationModel,
+             public PMSMControlLaw {
+public:
+  using State = Matrix<double, 6, 1>;
+
+  PMSM() : PMSM(PMSMParameters{}) {}
+  explicit PMSM(const PMSMParameters &p,
+                const PMSMControllerParameters &c = {})
+      : SimulationModel(6), PMSMControlLaw(p, c) {}
+
+  void operator()(double t, const VectorXd &x, VectorXd &xdot) const override {
+    fx(t, x, xdot);
+  }
+  void operator()(double t, const State &x, State &xdot) const {
+    fx(t, x, xdot);
+  }
+
+  // inputs
+  double Tl{0.08};    // load torque after t_load
+  double t_load{0.5}; // load torque step time
+
+private:
+  template <typename State, typename StateDot>
+  void fx(double t, const State &x, StateDot &xdot) const {
+    double id = x(0);
+    double iq = x(1);
+    double w = x(2);
+
+    double Tl_t = t < t_load ? 0.0 : Tl;
+
+    // controller
+    Output u = control(t, id, iq, w, x(3), x(4), x(5));
+
+    // state update
+    xdot(0) = 1 / p.Ld * (u.vd - p.Rs * id + p.np * w * p.Lq * iq);
+    xdot(1) =
+        1 / p.Lq * (u.vq - p.Rs * iq - p.np * w * (p.Ld * id + p.psi_r));
+    xdot(2) = 1 / p.J *
+              (3 * p.np / 2 * (p.psi_r * iq + (p.Ld - p.Lq) * id * iq) - Tl_t -
+               p.b * w);
+
+    // integrators, scaled as in python/main.py: one 1e-6 s step adds
+    // Tctrl * e, the sampled controller's increment per tick
+    xdot(3) = u.ed / 1e-6 * c.Tctrl;
+    xdot(4) = u.eq / 1e-6 * c.Tctrl;
+    xdot(5) = u.es / 1e-6 * c.Tctrl;
+  }
+};
+/* ---------------------------------------------------- */
+
+/* ---------------------------------------------------- */
+/* Sampled closed-loop controller for the open-loop PMSM */
+/* ---------------------------------------------------- */
+// Discrete-time counterpart of PMSM for RungeKutta's hybrid solve: on every
+// tick it evaluates the control law once, writes vd, vq into the plant,
+// where they are held until the next tick, and adds Tctrl * e to the
+// integrator states. This is the sample-and-hold block commented out in
+// python/main.py.
+//
+// Example: PMSMOpenLoop plant;
+//          PMSMController ctrl(plant);
+//          RungeKutta<PMSMOpenLoop, 3> rk(plant);
+//          rk.solve(t0, T, x0, dt, sink, ctrl.c.Tctrl, ctrl);
+class PMSMController : public PMSMControlLaw {
+public:
+  explicit PMSMController(PMSMOpenLoop &plant,
+                          const PMSMControllerParameters &c = {})
+      : PMSMControlLaw(plant.p, c), plant(plant) {
+    plant.vd = plant.vq = 0.0;
+    plant.t_vq = 0.0;
+  }
+
+  template <typename State> void operator()(double t, const State &x) {
+    Output u = control(t, x(0), x(1), x(2), Id, Iq, Is);
+    plant.vd = u.vd;
+    plant.vq = u.vq;
+    Id += c.Tctrl * u.ed;
+    Iq += c.Tctrl * u.eq;
+    Is += c.Tctrl * u.es;
+  }
+
+  /* Clear the integrator states and the held voltages before a new run */
+  void reset() {
+    Id = Iq = Is = 0.0;
+    plant.vd = plant.vq = 0.0;
+  }
+
+  /* Integrator states and held voltages, as Checkpoint::extra */
+  void save(std::vector<double> &extra) const {
+    extra = {Id, Iq, Is, plant.vd, plant.vq};
+  }
+  void restore(const std::vector<double> &extra) {
+    if (extra.size() != 5)
+      throw std::invalid_argument("PMSMController: expected 5 saved states");
+    Id = extra[0];
+    Iq = extra[1];
+    Is = extra[2];
+    plant.vd = extra[3];
+    plant.vq = extra[4];
+  }
+
+  // integrator states
+  double Id{0.0};
+  double Iq{0.0};
+  double Is{0.0};
+
+private:
+  PMSMOpenLoop &plant;
+};
+/* ---------------------------------------------------- */
+
+#endif // PMSM_H
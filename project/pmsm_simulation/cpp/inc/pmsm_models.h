@@ -0,0 +1,162 @@
+#ifndef PMSM_MODELS_H
+#define PMSM_MODELS_H
+
+#include <eigen3/Eigen/Dense>
+#include <vector>
+
+#include "simulators.h" // SimulationModel
+
+using namespace Eigen;
+
+/* ---------------------------------------------------- */
+/* PMSM parameters, defaults are the motor in python/main.py */
+/* ---------------------------------------------------- */
+struct PMSMParameters {
+  double Rs = 0.56;      // stator resistance
+  double Ld = 375e-6;    // d-axis inductance
+  double Lq = 435e-6;    // q-axis inductance
+  double psi_r = 0.0143; // rotor flux
+  double np = 2;         // pole pairs
+  double J = 0.12e-4;    // inertia
+  double b = 10e-6;      // viscous friction
+};
+/* ---------------------------------------------------- */
+
+/* ---------------------------------------------------- */
+/* Open-loop PMSM, single parameter set */
+/* ---------------------------------------------------- */
+// x[0] -> id, x[1] -> iq, x[2] -> omega, same inputs as PMSMEnsemble
+class PMSMOpenLoop : public FixedStepSimulators::SimulationModel {
+public:
+  PMSMOpenLoop() : SimulationModel(3) {}
+  explicit PMSMOpenLoop(const PMSMParameters &p)
+      : SimulationModel(3), p(p) {}
+
+  void operator()(double t, const VectorXd &x, VectorXd &xdot) const override {
+    fx(t, x, xdot);
+  }
+  void operator()(double t, const Vector3d &x, Vector3d &xdot) const {
+    fx(t, x, xdot);
+  }
+  // single-precision state, the model itself is evaluated in double
+  void operator()(double t, const Vector3f &x, Vector3f &xdot) const {
+    fx(t, x, xdot);
+  }
+  bool jacobian(double, const VectorXd &x, MatrixXd &J) const override {
+    return dfdx(x, J);
+  }
+  bool jacobian(double, const Vector3d &x, Matrix3d &J) const {
+    return dfdx(x, J);
+  }
+
+  PMSMParameters p; // motor parameters
+
+  // inputs
+  double vd{0.0};     // d-axis voltage
+  double vq{6.0};     // q-axis voltage after t_vq
+  double t_vq{0.0};   // q-axis voltage step time
+  double Tl{0.002};   // load torque after t_load
+  double t_load{0.5}; // load torque step time
+
+private:
+  template <typename State, typename StateDot>
+  void fx(double t, const State &x, StateDot &xdot) const {
+    double id = x(0);
+    double iq = x(1);
+    double omega = x(2);
+
+    double vq_t = t < t_vq ? 0.0 : vq;
+    double Tl_t = t < t_load ? 0.0 : Tl;
+
+    xdot(0) = 1 / p.Ld * (vd - p.Rs * id + p.np * omega * p.Lq * iq);
+    xdot(1) =
+        1 / p.Lq * (vq_t - p.Rs * iq - p.np * omega * (p.Ld * id + p.psi_r));
+    xdot(2) = 1 / p.J *
+              (3 * p.np / 2 * (p.psi_r * iq + (p.Ld - p.Lq) * id * iq) - Tl_t -
+               p.b * omega);
+  }
+
+  // analytic Jacobian of fx
+  template <typename State, typename Jacobian>
+  bool dfdx(const State &x, Jacobian &J) const {
+    double id = x(0);
+    double iq = x(1);
+    double omega = x(2);
+
+    J(0, 0) = -p.Rs / p.Ld;
+    J(0, 1) = p.np * omega * p.Lq / p.Ld;
+    J(0, 2) = p.np * p.Lq * iq / p.Ld;
+    J(1, 0) = -p.np * omega * p.Ld / p.Lq;
+    J(1, 1) = -p.Rs / p.Lq;
+    J(1, 2) = -p.np * (p.Ld * id + p.psi_r) / p.Lq;
+    J(2, 0) = 3 * p.np / 2 * (p.Ld - p.Lq) * iq / p.J;
+    J(2, 1) = 3 * p.np / 2 * (p.psi_r + (p.Ld - p.Lq) * id) / p.J;
+    J(2, 2) = -p.b / p.J;
+    return true;
+  }
+};
+/* ---------------------------------------------------- */
+
+/* ---------------------------------------------------- */
+/* Open-loop PMSM ensemble, one member per parameter set */
+/* ---------------------------------------------------- */
+// x[0] -> id, x[1] -> iq, x[2] -> omega, one column per member. The inputs
+// are shared: vd, a step in vq at t_vq and a load torque step at t_load.
+// Parameters and arithmetic in Scalar, PMSMEnsemble is the double version.
+template <typename Scalar = double> class BasicPMSMEnsemble {
+public:
+  explicit BasicPMSMEnsemble(const std::vector<PMSMParameters> &params)
+      : m(params.size()), Rs(m), Ld(m), Lq(m), psi_r(m), np(m), b(m),
+        inv_Ld(m), inv_Lq(m), inv_J(m) {
+    for (Index k = 0; k < m; ++k) {
+      Rs(k) = params[k].Rs;
+      Ld(k) = params[k].Ld;
+      Lq(k) = params[k].Lq;
+      psi_r(k) = params[k].psi_r;
+      np(k) = params[k].np;
+      b(k) = params[k].b;
+      inv_Ld(k) = 1 / params[k].Ld;
+      inv_Lq(k) = 1 / params[k].Lq;
+      inv_J(k) = 1 / params[k].J;
+    }
+  }
+
+  template <typename Derived, typename DerivedDot>
+  void operator()(double t, const MatrixBase<Derived> &X,
+                  MatrixBase<DerivedDot> &Xdot) const {
+    auto id = X.row(0).array();
+    auto iq = X.row(1).array();
+    auto omega = X.row(2).array();
+
+    const Scalar vd_t = static_cast<Scalar>(vd);
+    const Scalar vq_t = static_cast<Scalar>(t < t_vq ? 0.0 : vq);
+    const Scalar Tl_t = static_cast<Scalar>(t < t_load ? 0.0 : Tl);
+
+    Xdot.row(0).array() = inv_Ld * (vd_t - Rs * id + np * omega * Lq * iq);
+    Xdot.row(1).array() =
+        inv_Lq * (vq_t - Rs * iq - np * omega * (Ld * id + psi_r));
+    Xdot.row(2).array() =
+        inv_J * (Scalar(1.5) * np * (psi_r * iq + (Ld - Lq) * id * iq) - Tl_t -
+                 b * omega);
+  }
+
+  Index n{3}; // states per member
+  Index m;    // members
+
+  // shared inputs
+  double vd{0.0};     // d-axis voltage
+  double vq{6.0};     // q-axis voltage after t_vq
+  double t_vq{0.0};   // q-axis voltage step time
+  double Tl{0.002};   // load torque after t_load
+  double t_load{0.5}; // load torque step time
+
+private:
+  using Row = Array<Scalar, 1, Dynamic>;
+  Row Rs, Ld, Lq, psi_r, np, b;
+  Row inv_Ld, inv_Lq, inv_J;
+};
+
+using PMSMEnsemble = BasicPMSMEnsemble<double>;
+/* ---------------------------------------------------- */
+
+#endif // PMSM_MODELS_H
@@ -0,0 +1,274 @@
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <new>
+#include <pthread.h>
+#include <sched.h>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <type_traits>
+#include <unistd.h>
+#include <utility>
+
+/*! Soft real-time pacing for hardware-in-the-loop runs (Linux only)
+ *
+ * PacedLoop runs a frame function on absolute CLOCK_MONOTONIC deadlines,
+ * SpscRing and SharedMemory carry samples to and from a controller in
+ * another process.
+ *
+ * Example: RealTime::configure_thread(2, 80); // core 2, SCHED_FIFO 80
+ *          RealTime::PacedLoop loop(50e-6);
+ *          loop.run(n_frames, [&](size_t) {
+ *            rk.step_to(rk.time() + 50e-6, 10e-6);
+ *          });
+ *          fmt::print("{} overruns\n", loop.stats.n_overruns);
+ */
+namespace RealTime {
+
+/* Pin the calling thread to a core (cpu >= 0) and switch it to SCHED_FIFO
+ * (priority > 0). Needs CAP_SYS_NICE or a matching RLIMIT_RTPRIO. */
+inline void configure_thread(int cpu, int priority) {
+  if (cpu >= 0) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err != 0)
+      throw std::runtime_error("RealTime: cannot pin to core " +
+                               std::to_string(cpu) + ": " +
+                               std::strerror(err));
+  }
+  if (priority > 0) {
+    sched_param param{};
+    param.sched_priority = priority;
+    int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (err != 0)
+      throw std::runtime_error("RealTime: cannot set SCHED_FIFO priority " +
+                               std::to_string(priority) + ": " +
+                               std::strerror(err));
+  }
+}
+
+/* ---------------------------------------------------- */
+/* Frame timing statistics */
+/* ---------------------------------------------------- */
+// Wake-up latency (jitter) is the time from a deadline to the return of
+// clock_nanosleep. The histogram bins double in width, bin 0 is below 1 us,
+// bin b covers [2^(b-1), 2^b) us and the last bin everything above. A frame
+// overruns when its work ends after the next deadline.
+struct FrameStats {
+  static constexpr size_t n_bins = 12;
+
+  void record(int64_t latency_ns, int64_t work_ns, bool overrun) {
+    ++n_frames;
+    n_overruns += overrun;
+    latency_sum += latency_ns;
+    latency_max = std::max(latency_max, latency_ns);
+    work_max = std::max(work_max, work_ns);
+    size_t bin = 0;
+    for (int64_t us = latency_ns / 1000; us > 0 && bin + 1 < n_bins; us /= 2)
+      ++bin;
+    ++histogram[bin];
+  }
+
+  /* Latency range [lo, hi) of bin b in us */
+  static std::pair<int64_t, int64_t> bin_range_us(size_t b) {
+    return {b == 0 ? 0 : int64_t{1} << (b - 1), int64_t{1} << b};
+  }
+
+  double latency_mean_us() const {
+    return n_frames ? 1e-3 * latency_sum / n_frames : 0.0;
+  }
+
+  size_t n_frames{0};
+  size_t n_overruns{0};
+  int64_t latency_sum{0}; // ns
+  int64_t latency_max{0}; // ns
+  int64_t work_max{0};    // ns, longest frame function call
+  std::array<size_t, n_bins> histogram{};
+};
+/* ---------------------------------------------------- */
+
+/* ---------------------------------------------------- */
+/* Fixed-period loop on absolute deadlines */
+/* ---------------------------------------------------- */
+// The deadlines are t_start + k * period, so sleep errors do not accumulate.
+// After an overrun the schedule is kept, the following frames start late
+// and catch up without sleeping, which keeps simulated and wall-clock time
+// aligned.
+class PacedLoop {
+public:
+  explicit PacedLoop(double period)
+      : period_ns(static_cast<int64_t>(period * 1e9)) {
+    if (period_ns <= 0)
+      throw std::invalid_argument("PacedLoop: period must be positive");
+  }
+
+  /* Call frame(k) for k = 0 .. n_frames - 1, one per period */
+  template <typename Frame> void run(size_t n_frames, Frame &&frame) {
+    stats = FrameStats{};
+    timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    for (size_t k = 0; k < n_frames; ++k) {
+      add_ns(deadline, period_ns);
+      while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline,
+                             nullptr) == EINTR) {
+      }
+      int64_t wake = now_ns();
+      frame(k);
+      int64_t done = now_ns();
+      int64_t due = to_ns(deadline);
+      stats.record(wake - due, done - wake, done > due + period_ns);
+    }
+  }
+
+  FrameStats stats; // statistics of the last run
+
+private:
+  static int64_t to_ns(const timespec &ts) {
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+  }
+  static int64_t now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return to_ns(ts);
+  }
+  static void add_ns(timespec &ts, int64_t ns) {
+    ns += ts.tv_nsec;
+    ts.tv_sec += ns / 1000000000;
+    ts.tv_nsec = ns % 1000000000;
+  }
+
+  int64_t period_ns;
+};
+/* ---------------------------------------------------- */
+
+/* ---------------------------------------------------- */
+/* Lock-free single-producer single-consumer ring */
+/* ---------------------------------------------------- */
+// Fixed capacity, no heap, so it can live in shared memory between two
+// processes. Capacity must be a power of two. The indices only grow, the
+// producer owns head and the consumer tail, each on its own cache line.
+template <typename T, size_t Capacity> class SpscRing {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "SpscRing: T is copied between processes");
+  static_assert((Capacity & (Capacity - 1)) == 0,
+                "SpscRing: Capacity must be a power of two");
+  static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+public:
+  /* Producer side, false if the ring is full */
+  bool push(const T &value) {
+    uint64_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) == Capacity)
+      return false;
+    slots[h & (Capacity - 1)] = value;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  /* Consumer side, false if the ring is empty */
+  bool pop(T &value) {
+    uint64_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire))
+      return false;
+    value = slots[t & (Capacity - 1)];
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  /* Consumer side, drop everything but the newest element */
+  bool pop_latest(T &value) {
+    bool any = false;
+    while (pop(value))
+      any = true;
+    return any;
+  }
+
+private:
+  alignas(64) std::atomic<uint64_t> head{0};
+  alignas(64) std::atomic<uint64_t> tail{0};
+  alignas(64) std::array<T, Capacity> slots;
+};
+/* ---------------------------------------------------- */
+
+/* ---------------------------------------------------- */
+/* POSIX shared-memory object holding one T */
+/* ---------------------------------------------------- */
+// The creating side constructs T and removes the name on destruction, the
+// opening side maps the existing object. Open it after fork() or from another
+// process with the same name.
+template <typename T> class SharedMemory {
+public:
+  static SharedMemory create(const std::string &name) {
+    return SharedMemory(name, true);
+  }
+  static SharedMemory open(const std::string &name) {
+    return SharedMemory(name, false);
+  }
+
+  SharedMemory(SharedMemory &&other) noexcept
+      : name(std::move(other.name)), owner(other.owner),
+        ptr(std::exchange(other.ptr, nullptr)) {}
+  SharedMemory(const SharedMemory &) = delete;
+  SharedMemory &operator=(const SharedMemory &) = delete;
+
+  ~SharedMemory() {
+    if (!ptr)
+      return;
+    if (owner)
+      ptr->~T();
+    munmap(ptr, sizeof(T));
+    if (owner)
+      shm_unlink(name.c_str());
+  }
+
+  T *operator->() const { return ptr; }
+  T &operator*() const { return *ptr; }
+
+private:
+  SharedMemory(const std::string &name, bool create)
+      : name(name), owner(create) {
+    int fd = shm_open(name.c_str(), create ? O_CREAT | O_EXCL | O_RDWR : O_RDWR,
+                      0600);
+    if (fd < 0)
+      throw std::runtime_error("SharedMemory: shm_open " + name + ": " +
+                               std::strerror(errno));
+    if (create && ftruncate(fd, sizeof(T)) != 0) {
+      int err = errno;
+      close(fd);
+      shm_unlink(name.c_str());
+      throw std::runtime_error("SharedMemory: ftruncate " + name + ": " +
+                               std::strerror(err));
+    }
+    void *p =
+        mmap(nullptr, sizeof(T), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int err = errno;
+    close(fd);
+    if (p == MAP_FAILED) {
+      if (create)
+        shm_unlink(name.c_str());
+      throw std::runtime_error("SharedMemory: mmap " + name + ": " +
+                               std::strerror(err));
+    }
+    ptr = create ? new (p) T() : static_cast<T *>(p);
+  }
+
+  std::string name;
+  bool owner;
+  T *ptr{nullptr};
+};
+/* ---------------------------------------------------- */
+
+} // namespace RealTime
+
+#endif // REALTIME_H
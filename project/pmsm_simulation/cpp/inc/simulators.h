@@ -1,7 +1,15 @@
 #ifndef SIMULATORS_H
 #define SIMULATORS_H
 
+#include <algorithm>
+#include <cmath>
 #include <eigen3/Eigen/Dense>
+#include <stdexcept>
+#include <utility>
+
+#include "checkpoint.h" // Checkpoint
+#include "events.h"     // Events
+#include "profiler.h"   // PROFILE_ZONE
 
 using namespace Eigen;
 
@@ -15,72 +23,316 @@ public:
   explicit SimulationModel(size_t n_in) : n(n_in) {}
   virtual void operator()(double t, const VectorXd &x,
                           VectorXd &xdot) const = 0;
+  // optional Jacobian df/dx for the implicit simulators, false -> finite
+  // differences
+  virtual bool jacobian(double, const VectorXd &, MatrixXd &) const {
+    return false;
+  }
   size_t n{0};
 };
 
-/* Runge-Kutta 4th order method */
+/* sum += value as a compensated (Kahan) sum, the rounding error of each
+ * addition is kept in comp and fed into the next, so a time that advances
+ * by dt does not drift off its grid over long horizons */
+inline void kahan_add(double &sum, double &comp, double value) {
+  double y = value - comp;
+  double s = sum + y;
+  comp = (s - sum) - y;
+  sum = s;
+}
+
+/* Runge-Kutta 4th order method
+ *
+ * Model: any type callable as model(t, x, xdot). With the defaults the model
+ *        is called through the virtual SimulationModel interface and the
+ *        state is a heap-backed VectorXd of size model.n.
+ * N:     state dimension. A fixed N stores the state and the stages in
+ *        Matrix<Scalar, N, 1> (no heap, unrolled loops) and, with a concrete
+ *        Model type, lets the compiler inline the model call.
+ * Scalar: state and stage arithmetic, float for runs that only need about
+ *        1e-4 relative accuracy. Time is always double and accumulated with
+ *        a compensated sum.
+ *
+ * Example: RungeKutta<PMSM, 3> rk(pmsm);          // fixed-size, inlined
+ *          RungeKutta<PMSM, 3, float> rk_f(pmsm); // single precision
+ *          RungeKutta rk(pmsm);                   // dynamic-size fallback
+ */
+template <typename Model = SimulationModel, int N = Dynamic,
+          typename Scalar = double>
 class RungeKutta {
 public:
-  explicit RungeKutta(const SimulationModel &model)
-      : x(model.n), model(model), k1(model.n), k2(model.n), k3(model.n),
-        k4(model.n), tmp(model.n) {}
+  using State = Matrix<Scalar, N, 1>;
+  using Trajectory = Matrix<Scalar, N, Dynamic>;
+
+  explicit RungeKutta(const Model &model)
+      : x(dim(model)), model(model), k1(dim(model)), k2(dim(model)),
+        k3(dim(model)), k4(dim(model)), tmp(dim(model)), x_prev(dim(model)),
+        x_next(dim(model)) {}
 
   void step(const double &dt) {
-    // ugly but avoids allocations
-    // model(t, x, k1);
-    // tmp = x + 0.5 * dt * k1;
-    // model(t + 0.5 * dt, tmp, k2);
-    // tmp = x + 0.5 * dt * k2;
-    // model(t + 0.5 * dt, tmp, k3);
-    // tmp = x + dt * k3;
-    // model(t + dt, tmp, k4);
+    PROFILE_ZONE("RungeKutta::step");
+    // stages are evaluated into the preallocated tmp buffer, passing
+    // x + 0.5 * dt * k1 directly would bind a heap temporary per stage
+    const Scalar h = static_cast<Scalar>(dt);
+    eval(t, x, k1);
+    tmp.noalias() = x + Scalar(0.5) * h * k1;
+    eval(t + 0.5 * dt, tmp, k2);
+    tmp.noalias() = x + Scalar(0.5) * h * k2;
+    eval(t + 0.5 * dt, tmp, k3);
+    tmp.noalias() = x + h * k3;
+    eval(t + dt, tmp, k4);
+
+    x += h / 6 * (k1 + 2 * k2 + 2 * k3 + k4);
+  }
+
+  /* Simulate from t0 to T and store the full trajectory */
+  auto solve(const double &t0, const double &T, const State &x0,
+             const double &dt) -> std::pair<VectorXd, Trajectory> {
+
+    size_t N_smp = n_samples(t0, T, dt);
+    VectorXd ts = VectorXd::Zero(N_smp);
+    Trajectory xs = Trajectory::Zero(x.size(), N_smp);
+
+    size_t i = 0;
+    solve(t0, T, x0, dt, [&](double t_i, const State &x_i) {
+      ts(i) = t_i;       // store time
+      xs.col(i++) = x_i; // store state
+    });
+
+    return {std::move(ts), std::move(xs)};
+  }
 
-    model(t, x, k1);
-    model(t + 0.5 * dt, x + 0.5 * dt * k1, k2);
-    model(t + 0.5 * dt, x + 0.5 * dt * k2, k3);
-    model(t + dt, x + dt * k3, k4);
+  /* Simulate from t0 to T and hand every sample to sink(t, x) instead of
+   * storing it, see sinks.h for decimating and ring-buffer sinks */
+  template <typename Sink>
+  void solve(const double &t0, const double &T, const State &x0, double dt,
+             Sink &&sink) {
+    integrate(t0, T, dt, 0, t0, x0, true, sink, 0,
+              [](double, const State &) {}, nullptr);
+  }
+
+  /* Simulate with time events and zero crossings, see events.h. Steps that
+   * contain an event are split at it, the samples stay on the dt grid. */
+  template <typename Sink>
+  void solve(const double &t0, const double &T, const State &x0, double dt,
+             Sink &&sink, Events<N, Scalar> &events) {
+    integrate(t0, T, dt, 0, t0, x0, true, sink, 0,
+              [](double, const State &) {}, &events);
+  }
 
-    x += dt / 6 * (k1 + 2 * k2 + 2 * k3 + k4);
+  /* Hybrid simulation with a discrete-time controller. controller(t, x)
+   * fires every Tctrl, on the step boundaries starting at t0, and writes its
+   * outputs into the model's inputs. They are held (zero-order hold) while
+   * the plant integrates to the next tick, so the controller runs once per
+   * period instead of on every stage. Tctrl must be a multiple of dt. */
+  template <typename Sink, typename Controller>
+  void solve(const double &t0, const double &T, const State &x0, double dt,
+             Sink &&sink, double Tctrl, Controller &&controller) {
+    integrate(t0, T, dt, 0, t0, x0, true, sink, ticks(Tctrl, dt), controller,
+              nullptr);
   }
 
-  auto solve(const double &t0, const double &T, const VectorXd &x0, double &dt)
-      -> std::pair<VectorXd, MatrixXd> {
+  /* Solver state at the current sample of solve or resume, or at the last
+   * sample once they return, see checkpoint.h */
+  Checkpoint<N> checkpoint() const {
+    Checkpoint<N> ck;
+    ck.t0 = t_grid;
+    ck.dt = dt_grid;
+    ck.index = i_smp;
+    ck.t = t;
+    ck.t_comp = t_comp;
+    ck.x = x.template cast<double>();
+    return ck;
+  }
+  size_t sample_index() const { return i_smp; }
 
-    size_t N = std::ceil((T - t0) / dt) + 1;
-    VectorXd ts = VectorXd::Zero(N);
-    MatrixXd xs = MatrixXd::Zero(model.n, N);
+  /* Continue a run from a checkpoint to T, on the checkpoint's sample grid.
+   * The checkpoint sample itself is not handed to the sink again, so the
+   * samples of the first run and the resumed one concatenate to those of an
+   * uninterrupted run. Several runs may fork from the same checkpoint. */
+  template <typename Sink>
+  void resume(const Checkpoint<N> &ck, const double &T, Sink &&sink) {
+    check_grid(ck);
+    integrate(ck.t0, T, ck.dt, ck.index, ck.t, ck.x.template cast<Scalar>(),
+              false, sink, 0, [](double, const State &) {}, nullptr,
+              ck.t_comp);
+  }
 
+  /* Resume a hybrid run, controller state is the caller's (ck.extra) */
+  template <typename Sink, typename Controller>
+  void resume(const Checkpoint<N> &ck, const double &T, Sink &&sink,
+              double Tctrl, Controller &&controller) {
+    check_grid(ck);
+    integrate(ck.t0, T, ck.dt, ck.index, ck.t, ck.x.template cast<Scalar>(),
+              false, sink, ticks(Tctrl, ck.dt), controller, nullptr,
+              ck.t_comp);
+  }
+
+  /* Stepping by hand, for loops that own the clock (see realtime.h):
+   * reset to (t0, x0), then step_to(t_end, dt) repeatedly. The last step
+   * before t_end is shortened to land on it. */
+  void reset(double t0, const State &x0) {
     t = t0;
+    t_comp = 0.0;
     x = x0;
-    for (size_t i = 0; i < N; ++i) {
-      ts(i) = t; // store time
+  }
+  void step_to(double t_end, double dt) {
+    while (t < t_end) {
+      bool last = t_end - t <= dt * (1 + 1e-9); // no sliver steps
+      step(last ? t_end - t : dt);
+      t = last ? t_end : t + dt;
+    }
+  }
+  double time() const { return t; }
+  const State &state() const { return x; }
 
-      // std::ranges::copy(x, std::begin(xs) + i * model.n);
-      xs.col(i) = x; // store state
+  /* Number of samples solve produces, including both end points */
+  static size_t n_samples(const double &t0, const double &T,
+                          const double &dt) {
+    return std::ceil((T - t0) / dt) + 1;
+  }
+
+private:
+  // controller period in steps
+  static size_t ticks(double Tctrl, double dt) {
+    double n_sub = std::round(Tctrl / dt);
+    if (n_sub < 1 || std::abs(n_sub * dt - Tctrl) > 1e-9 * Tctrl)
+      throw std::invalid_argument(
+          "RungeKutta: Tctrl must be a multiple of dt");
+    return static_cast<size_t>(n_sub);
+  }
+
+  // a checkpoint taken after a shortened last step is off the grid
+  static void check_grid(const Checkpoint<N> &ck) {
+    if (!(ck.dt > 0.0) ||
+        std::abs(ck.t - (ck.t0 + ck.index * ck.dt)) > 1e-6 * ck.dt)
+      throw std::invalid_argument(
+          "RungeKutta: checkpoint is not on its dt grid, end the first run "
+          "on a multiple of dt");
+  }
+
+  // fixed-step loop on the grid t0 + i dt, from sample i_first at
+  // (t_first, x_first), which goes to the sink only if emit_first.
+  // controller(t, x) fires before every `every`-th step (never when every
+  // is 0), events may be null. t_comp carries a resumed run's compensation.
+  template <typename Sink, typename Controller>
+  void integrate(const double &t0, const double &T, double dt,
+                 size_t i_first, double t_first, const State &x_first,
+                 bool emit_first, Sink &&sink, size_t every,
+                 Controller &&controller, Events<N, Scalar> *events,
+                 double t_comp_first = 0.0) {
+    PROFILE_ZONE("RungeKutta::solve");
+
+    size_t N_smp = n_samples(t0, T, dt);
+
+    t_grid = t0;
+    dt_grid = dt;
+    t = t_first;
+    t_comp = t_comp_first;
+    x = x_first;
+    if (events)
+      events->start(t, x);
+    for (size_t i = i_first; i < N_smp; ++i) {
+      i_smp = i;
+      if (i != i_first || emit_first) {
+        PROFILE_ZONE("RungeKutta::sink");
+        sink(t, x);
+      }
+
+      if (i + 1 == N_smp)
+        break; // last sample, no step past T
+
+      if (every != 0 && i % every == 0) {
+        PROFILE_ZONE("RungeKutta::controller");
+        controller(t, x);
+      }
 
       if ((t + dt) > T)
         dt = T - t; // adjust time step
 
-      step(dt);
-      t += dt;
+      if (events) {
+        advance(dt, *events);
+        t_comp = 0.0;
+      } else {
+        step(dt);
+        kahan_add(t, t_comp, dt);
+      }
     }
+  }
 
-    return {ts, xs};
+  // one grid step of size dt, split at the events inside it
+  void advance(double dt, Events<N, Scalar> &events) {
+    const double t_end = t + dt;
+    while (t < t_end) {
+      const double t_e = events.next_time();
+      const double t_next = std::min(t_e, t_end);
+
+      const double t_prev = t;
+      x_prev = x;
+      step(t_next - t);
+      x_next = x;
+
+      // re-step from the start of the step to any t inside it
+      double t_c;
+      int k = events.locate(
+          t_prev, t_next, x_next,
+          [&](double t_s) -> const State & {
+            t = t_prev;
+            x = x_prev;
+            step(t_s - t_prev);
+            return x;
+          },
+          t_c);
+
+      if (k >= 0) {
+        t = t_prev;
+        x = x_prev;
+        step(t_c - t_prev);
+        t = t_c;
+        events.fire_crossing(k, t, x);
+        continue;
+      }
+
+      events.accept();
+      t = t_next;
+      x = x_next;
+      if (t_next == t_e)
+        events.fire_time(t, x);
+    }
   }
 
-private:
-  VectorXd x;
+  // model evaluation, a separate zone from the stage arithmetic in step
+  void eval(double t_s, const State &x_s, State &xdot) {
+    PROFILE_ZONE("RungeKutta::model");
+    model(t_s, x_s, xdot);
+  }
+
+  // state dimension, taken from the model only for dynamic-size states
+  static Index dim(const Model &model) {
+    if constexpr (N == Dynamic)
+      return static_cast<Index>(model.n);
+    else
+      return N;
+  }
+
+  State x;
   double t{0.0};
+  double t_comp{0.0};  // running compensation of t
+  double t_grid{0.0};  // start of the sample grid of the current run
+  double dt_grid{0.0}; // its time step
+  size_t i_smp{0};     // current sample index
 
-  const SimulationModel &model;
+  const Model &model;
 
-  VectorXd k1;
-  VectorXd k2;
-  VectorXd k3;
-  VectorXd k4;
-  VectorXd tmp;
+  State k1;
+  State k2;
+  State k3;
+  State k4;
+  State tmp;
+  State x_prev; // event steps, start of the step
+  State x_next; // event steps, end of the step
 };
 
 } // namespace FixedStepSimulators
 
-#endif // SIMULATORS_H
\ No newline at end of file
+#endif // SIMULATORS_H
@@ -0,0 +1,125 @@
+#ifndef SINKS_H
+#define SINKS_H
+
+#include <algorithm>
+#include <cmath>
+#include <eigen3/Eigen/Dense>
+#include <stdexcept>
+#include <utility>
+
+using namespace Eigen;
+
+namespace FixedStepSimulators {
+/*! Trajectory sinks for RungeKutta::solve(t0, T, x0, dt, sink)
+ *
+ * A sink is any callable sink(t, x). The sinks below allocate once, in their
+ * constructor, so memory is O(window) instead of O(number of steps). Stored
+ * samples are kept in Scalar, float halves the memory of a long history.
+ */
+
+/* Store every k-th sample, reset() before reusing the sink for another
+ * solve */
+template <int N = Dynamic, typename Scalar = double> class DecimatingSink {
+public:
+  using Trajectory = Matrix<Scalar, N, Dynamic>;
+
+  // n: state dimension, N_smp: samples produced by the solver
+  DecimatingSink(Index n, size_t N_smp, size_t every)
+      : every(every), ts(VectorXd::Zero(capacity(N_smp, every))),
+        xs(Trajectory::Zero(n, ts.size())) {}
+
+  template <typename Derived>
+  void operator()(double t, const MatrixBase<Derived> &x) {
+    if (i_smp++ % every != 0)
+      return;
+    if (n_stored == ts.size())
+      throw std::out_of_range("DecimatingSink: full, reset() before reuse");
+    ts(n_stored) = t;
+    xs.col(n_stored++) = x.template cast<Scalar>();
+  }
+
+  /* Start over, the next sample is stored first */
+  void reset() { i_smp = n_stored = 0; }
+
+  size_t every;
+  VectorXd ts;   // stored times
+  Trajectory xs; // stored states
+
+private:
+  static Index capacity(size_t N_smp, size_t every) {
+    if (every == 0)
+      throw std::invalid_argument("DecimatingSink: every must be positive");
+    return static_cast<Index>((N_smp + every - 1) / every);
+  }
+
+  size_t i_smp{0};
+  Index n_stored{0};
+};
+
+/* Keep the last `window` samples */
+template <int N = Dynamic, typename Scalar = double> class RingBufferSink {
+public:
+  using Trajectory = Matrix<Scalar, N, Dynamic>;
+
+  RingBufferSink(Index n, Index window)
+      : ts(VectorXd::Zero(window)), xs(Trajectory::Zero(n, window)) {}
+
+  template <typename Derived>
+  void operator()(double t, const MatrixBase<Derived> &x) {
+    ts(head) = t;
+    xs.col(head) = x.template cast<Scalar>();
+    head = (head + 1) % ts.size();
+    size = std::min(size + 1, ts.size());
+  }
+
+  // samples in chronological order (allocates)
+  auto ordered() const -> std::pair<VectorXd, Trajectory> {
+    VectorXd ts_out(size);
+    Trajectory xs_out(xs.rows(), size);
+    Index first = (head - size + ts.size()) % ts.size();
+    for (Index i = 0; i < size; ++i) {
+      ts_out(i) = ts((first + i) % ts.size());
+      xs_out.col(i) = xs.col((first + i) % ts.size());
+    }
+    return {std::move(ts_out), std::move(xs_out)};
+  }
+
+  VectorXd ts;   // time ring buffer
+  Trajectory xs; // state ring buffer
+  Index head{0}; // next slot to write
+  Index size{0}; // number of valid samples
+};
+
+/* Final state and per-state min / max / mean, no history, accumulated in
+ * double for any solver Scalar */
+template <int N = Dynamic> class StatisticsSink {
+public:
+  using State = Matrix<double, N, 1>;
+
+  explicit StatisticsSink(Index n)
+      : x_final(State::Zero(n)), x_min(State::Constant(n, INFINITY)),
+        x_max(State::Constant(n, -INFINITY)), x_sum(State::Zero(n)) {}
+
+  template <typename Derived>
+  void operator()(double t, const MatrixBase<Derived> &x) {
+    t_final = t;
+    x_final = x.template cast<double>();
+    x_min = x_min.cwiseMin(x_final);
+    x_max = x_max.cwiseMax(x_final);
+    x_sum += x_final;
+    ++count;
+  }
+
+  State mean() const { return x_sum / static_cast<double>(count); }
+
+  double t_final{0.0};
+  State x_final;
+  State x_min;
+  State x_max;
+  State x_sum;
+  size_t count{0};
+};
+
+} // namespace FixedStepSimulators
+
+#endif // SINKS_H
@@ -3,20 +3,22 @@
 #include <chrono>
 #include <thread>
 
+// Coarse wall-clock timer for whole runs, see profiler.h (PROFILE_ZONE) for
+// per-zone statistics inside the solvers
 class Timer {
 public:
     void reset() { _time = 0; };
-    void tic() { start = std::chrono::high_resolution_clock::now(); };
+    void tic() { start = std::chrono::steady_clock::now(); };
     void toc()
     {
         _time +=
-            std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start)
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start)
                 .count();
     };
-    double elapsed() const { return (double)(_time) * 1e-3; }; // Return in milliseconds
+    double elapsed() const { return (double)(_time) * 1e-6; }; // Return in milliseconds
 
 private:
-    std::chrono::time_point<std::chrono::high_resolution_clock> start;
+    std::chrono::time_point<std::chrono::steady_clock> start;
 
     long long _time{0};
 };
@@ -1,77 +1,98 @@
 #include <cmath>
 #include <eigen3/Eigen/Dense>
 #include <fmt/core.h>
-#include <fstream>
-#include <iostream>
-#include <nlohmann/json.hpp>
 #include <string>
+#include <vector>
 
-#include "pmsm.h"       // PMSM class
-#include "simulators.h" // Fixed-step simulators
-#include "timer.h"      // Timer class
+#include "json_writer.h"       // Streaming JSON output
+#include "pmsm.h"              // PMSM class
+#include "profiler.h"          // Profiling zones
+#include "simulators.h"        // Fixed-step simulators
+#include "timer.h"             // Timer class
+#include "trajectory_writer.h" // Binary trajectory output
 
 using namespace Eigen;
-using nljson = nlohmann::json;
 
-// Raises a warning when using gcc compiler use clang instead. If you still want
-// to use gcc, you can suppress the warning by adding
-// -Wno-deprecated-declarations to the compiler flags.
+// Count heap allocations. Eigen allocates through std::malloc and not through
+// operator new, so malloc itself is wrapped (glibc only).
 static int n_allocations = 0;
-void *operator new(size_t size) {
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *malloc(size_t size) {
   ++n_allocations;
-  return malloc(size);
+  return __libc_malloc(size);
 }
 
-/* ---------------------------------------------------- */
-/* Function to reate a json file */
-/* ---------------------------------------------------- */
-void create_jsonfile(std::string filename, const nljson &json_obj) {
+/*! Main function, usage: pmsm_simulation [--json] */
+int main(int argc, char *argv[]) {
 
-  filename += ".json"; // Append .json to filename
-
-  std::ofstream file(filename);
-  if (file.is_open()) {
-    file << json_obj.dump(4); // Pretty print with 4 spaces
-    file.close();
-    std::cout << "saved to " << filename << std::endl;
-  } else {
-    std::cerr << "Unable to open file for writing" << std::endl;
-  }
-}
-/* ---------------------------------------------------- */
-
-/*! Main function */
-int main() {
+  // binary .npz output by default, JSON only on request (small runs)
+  bool save_json = argc > 1 && std::string(argv[1]) == "--json";
 
   // user defined parameters
   double t0 = 0.0;  // start time
   double T = 1.0;   // end time
   double dt = 1E-6; // time step
 
-  VectorXd x0 = VectorXd::Zero(3); // initial state
+  const int Nsim = 100; // back-to-back runs, as python/main.py
+
+  const PMSM::State x0 = PMSM::State::Zero(); // initial state
 
   // create PMSM object
   const PMSM pmsm;
-  FixedStepSimulators::RungeKutta rk(pmsm);
+  FixedStepSimulators::RungeKutta<PMSM, 6> rk(pmsm);
 
   VectorXd ts;
-  MatrixXd xs;
+  Matrix<double, 6, Dynamic> xs;
 
   Timer timer;
-  timer.tic();                                // start timer
-  std::tie(ts, xs) = rk.solve(t0, T, x0, dt); // simulate
-  timer.toc();                                // stop timer
+  timer.tic(); // start timer
+  {
+    PROFILE_ZONE("simulate");
+    std::tie(ts, xs) = rk.solve(t0, T, x0, dt); // simulate
+  }
+  timer.toc(); // stop timer
 
   fmt::print("Simulated {} data points in {} ms\n", ts.size(), timer.elapsed());
 
-  // create json object
-  nljson json_obj;
-  json_obj["t"] = ts;
-  for (size_t i = 0; i < pmsm.n; ++i) {
-    json_obj["x" + std::to_string(i)] = xs.row(i);
+  // simulating in the loop, every run overwrites the stored trajectory
+  std::vector<double> tsim(Nsim);
+  for (int i = 0; i < Nsim; ++i) {
+    Timer timer_i;
+    timer_i.tic();
+    size_t j = 0;
+    rk.solve(t0, T, x0, dt, [&](double t_j, const PMSM::State &x_j) {
+      ts(j) = t_j;
+      xs.col(j++) = x_j;
+    });
+    timer_i.toc();
+    tsim[i] = timer_i.elapsed();
   }
 
-  create_jsonfile("pmsm_sim_cpp", json_obj); // save to json file
+  double mean = 0.0;
+  for (double t_i : tsim)
+    mean += t_i / Nsim;
+  double var = 0.0;
+  for (double t_i : tsim)
+    var += (t_i - mean) * (t_i - mean) / Nsim;
+  fmt::print("{} simulations with {:.2f} ± {:.2f} ms each\n", Nsim, mean,
+             std::sqrt(var));
+
+  PROFILE_ZONE("save");
+  if (save_json) {
+    JsonWriter json("pmsm_sim_cpp"); // save to json file
+    json.begin_object();
+    json.field("t", ts);
+    for (size_t i = 0; i < pmsm.n; ++i) {
+      json.field(fmt::format("x{}", i), xs.row(i));
+    }
+    json.end_object();
+  } else {
+    NpzWriter npz("pmsm_sim_cpp"); // save to npz file
+    npz.write("t", ts);
+    for (size_t i = 0; i < pmsm.n; ++i) {
+      npz.write(fmt::format("x{}", i), xs.row(i));
+    }
+  }
 
   fmt::print("Number of allocations: {}\n", n_allocations);
 
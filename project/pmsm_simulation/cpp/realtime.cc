@@ -0,0 +1,163 @@
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <eigen3/Eigen/Dense>
+#include <fmt/core.h>
+#include <stdexcept>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+#include "pmsm.h"        // PMSMControlLaw, PMSMController
+#include "pmsm_models.h" // PMSMOpenLoop
+#include "realtime.h"    // PacedLoop, SpscRing, SharedMemory
+#include "simulators.h"  // Fixed-step simulators
+#include "sinks.h"       // Trajectory sinks
+
+using namespace Eigen;
+
+/* ---------------------------------------------------- */
+/* Plant <-> controller channel in shared memory */
+/* ---------------------------------------------------- */
+struct Measurement {
+  double t, id, iq, w; // plant outputs at t
+};
+struct Command {
+  double t, vd, vq; // voltages computed from the measurement at t
+};
+struct HilChannel {
+  RealTime::SpscRing<Measurement, 1024> measurements; // plant -> controller
+  RealTime::SpscRing<Command, 1024> commands;         // controller -> plant
+  std::atomic<bool> done{false};
+};
+/* ---------------------------------------------------- */
+
+/* Stand-in for the controller under test, a separate process that answers
+ * every Tctrl with the cascaded control law of pmsm.h */
+static void run_controller(const std::string &name, const PMSMParameters &p,
+                           const PMSMControllerParameters &c) {
+  auto channel = RealTime::SharedMemory<HilChannel>::open(name);
+  PMSMControlLaw law(p, c);
+  double Id = 0.0, Iq = 0.0, Is = 0.0; // integrator states
+  double t_tick = 0.0;                 // next controller tick
+  Measurement m;
+  while (!channel->done.load(std::memory_order_acquire)) {
+    if (!channel->measurements.pop(m)) {
+      std::this_thread::yield();
+      continue;
+    }
+    if (m.t < t_tick - 1e-9 * c.Tctrl)
+      continue; // between ticks
+    PMSMControlLaw::Output u = law.control(m.t, m.id, m.iq, m.w, Id, Iq, Is);
+    channel->commands.push({m.t, u.vd, u.vq});
+    Id += c.Tctrl * u.ed;
+    Iq += c.Tctrl * u.eq;
+    Is += c.Tctrl * u.es;
+    t_tick += c.Tctrl;
+  }
+}
+
+/*! Main function, usage: pmsm_realtime [T] [frame_us] [cpu] [priority]
+ *
+ * Runs the open-loop PMSM as a soft real-time plant, one frame of simulated
+ * time per frame of wall-clock time, against a controller process on the
+ * other end of a shared-memory channel. cpu >= 0 pins the plant thread,
+ * priority > 0 runs it under SCHED_FIFO. */
+int main(int argc, char *argv[]) {
+
+  // user defined parameters
+  double T = argc > 1 ? std::atof(argv[1]) : 1.0;              // end time
+  double frame = argc > 2 ? std::atof(argv[2]) * 1e-6 : 50e-6; // frame
+  int cpu = argc > 3 ? std::atoi(argv[3]) : -1;                // plant core
+  int priority = argc > 4 ? std::atoi(argv[4]) : 0;            // SCHED_FIFO
+  double dt = frame / 5;                                       // time step
+
+  PMSMOpenLoop plant;
+  plant.Tl = 0.08; // load step as in the closed-loop PMSM
+  PMSMControllerParameters c;
+  double n_ctrl = std::round(c.Tctrl / frame);
+  if (n_ctrl < 1 || std::abs(n_ctrl * frame - c.Tctrl) > 1e-9 * c.Tctrl) {
+    fmt::print("frame must divide Tctrl = {} us\n", c.Tctrl * 1e6);
+    return EXIT_FAILURE;
+  }
+
+  // channel and controller process
+  std::string name = "/pmsm_hil_" + std::to_string(getpid());
+  auto channel = RealTime::SharedMemory<HilChannel>::create(name);
+  pid_t controller = fork();
+  if (controller < 0) {
+    fmt::print("fork failed\n");
+    return EXIT_FAILURE;
+  }
+  if (controller == 0) {
+    run_controller(name, plant.p, c);
+    _exit(EXIT_SUCCESS);
+  }
+
+  try {
+    RealTime::configure_thread(cpu, priority);
+  } catch (const std::runtime_error &e) {
+    fmt::print("{}, continuing without it\n", e.what());
+  }
+
+  // paced plant: apply the newest command, advance one frame, publish
+  FixedStepSimulators::RungeKutta<PMSMOpenLoop, 3> rk(plant);
+  rk.reset(0.0, Vector3d::Zero());
+  plant.vd = plant.vq = 0.0;
+  plant.t_vq = 0.0;
+  size_t n_frames = static_cast<size_t>(std::round(T / frame));
+  size_t n_ticks = static_cast<size_t>(n_ctrl);
+  size_t n_late = 0, n_dropped = 0;
+  auto publish = [&] {
+    const Vector3d &x = rk.state();
+    if (!channel->measurements.push({rk.time(), x(0), x(1), x(2)}))
+      ++n_dropped;
+  };
+
+  RealTime::PacedLoop loop(frame);
+  publish();
+  loop.run(n_frames, [&](size_t k) {
+    Command cmd{};
+    bool fresh = channel->commands.pop_latest(cmd);
+    if (fresh) {
+      plant.vd = cmd.vd;
+      plant.vq = cmd.vq;
+    }
+    // on a controller tick the answer to this frame's measurement is due
+    if (k % n_ticks == 0 && !(fresh && cmd.t == rk.time()))
+      ++n_late;
+    rk.step_to((k + 1) * frame, dt);
+    publish();
+  });
+  channel->done.store(true, std::memory_order_release);
+  waitpid(controller, nullptr, 0);
+
+  // the same run offline, controller sampled by the solver
+  PMSMOpenLoop offline_plant;
+  offline_plant.Tl = plant.Tl;
+  PMSMController ctrl(offline_plant, c);
+  FixedStepSimulators::RungeKutta<PMSMOpenLoop, 3> rk_offline(offline_plant);
+  FixedStepSimulators::StatisticsSink<3> offline(3);
+  rk_offline.solve(0.0, n_frames * frame, Vector3d::Zero(), dt, offline,
+                   c.Tctrl, ctrl);
+
+  const RealTime::FrameStats &s = loop.stats;
+  fmt::print("{} frames of {:.0f} us, {} overruns, {} late commands, {} "
+             "dropped measurements\n",
+             s.n_frames, frame * 1e6, s.n_overruns, n_late, n_dropped);
+  fmt::print("wake-up latency {:.2f} us mean, {:.2f} us max, longest frame "
+             "{:.2f} us\n",
+             s.latency_mean_us(), 1e-3 * s.latency_max, 1e-3 * s.work_max);
+  for (size_t b = 0; b < s.histogram.size(); ++b) {
+    auto [lo, hi] = RealTime::FrameStats::bin_range_us(b);
+    if (b + 1 == s.histogram.size())
+      fmt::print("  >= {:4} us: {}\n", lo, s.histogram[b]);
+    else
+      fmt::print("  {:4}-{:4} us: {}\n", lo, hi, s.histogram[b]);
+  }
+  fmt::print("final speed {:.4f} rad/s, offline {:.4f} rad/s\n",
+             rk.state()(2), offline.x_final(2));
+
+  return 0;
+}
@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <cstdlib>
+#include <eigen3/Eigen/Dense>
+#include <fmt/core.h>
+#include <vector>
+
+#include "parameter_sweep.h" // Multi-threaded sweep runner
+#include "pmsm_models.h"     // PMSM parameters and models
+#include "simulators.h"      // Fixed-step simulators
+#include "sinks.h"           // Trajectory sinks
+
+using namespace Eigen;
+
+/* Result of one sweep job */
+struct SweepResult {
+  double omega_final{0.0}; // speed at T
+  double omega_max{0.0};   // peak speed
+  double iq_max{0.0};      // peak q-axis current
+};
+
+/* Per-worker model and solver, reused for every job of the worker; rk
+ * refers to pmsm, so the worker is neither copied nor moved */
+struct Worker {
+  Worker() : rk(pmsm) {}
+  Worker(const Worker &) = delete;
+  Worker &operator=(const Worker &) = delete;
+  PMSMOpenLoop pmsm;
+  FixedStepSimulators::RungeKutta<PMSMOpenLoop, 3> rk;
+};
+
+/*! Main function, usage: pmsm_sweep [n_threads] */
+int main(int argc, char *argv[]) {
+
+  // user defined parameters
+  double t0 = 0.0;  // start time
+  double T = 1.0;   // end time
+  double dt = 1E-6; // time step
+
+  // parameter grid, +-20 % in Rs, J and psi_r around the nominal motor
+  const int n_grid = 8;
+  std::vector<PMSMParameters> params;
+  for (int i = 0; i < n_grid; ++i) {
+    for (int j = 0; j < n_grid; ++j) {
+      for (int k = 0; k < n_grid; ++k) {
+        PMSMParameters p;
+        p.Rs *= 0.8 + 0.4 * i / (n_grid - 1);
+        p.J *= 0.8 + 0.4 * j / (n_grid - 1);
+        p.psi_r *= 0.8 + 0.4 * k / (n_grid - 1);
+        params.push_back(p);
+      }
+    }
+  }
+
+  SweepOptions opts;
+  if (argc > 1)
+    opts.n_threads = std::atoi(argv[1]);
+  opts.progress = [dt, T, t0](size_t done, size_t total, double elapsed) {
+    fmt::print("{:5}/{} runs, {:.1f} s, {:.2f} Msteps/s\n", done, total,
+               elapsed, done * (T - t0) / dt / elapsed * 1e-6);
+  };
+
+  auto results = run_sweep<SweepResult>(
+      params.size(), [] { return Worker(); },
+      [&](Worker &w, size_t job) {
+        w.pmsm.p = params[job];
+        FixedStepSimulators::StatisticsSink<3> stats(3);
+        w.rk.solve(t0, T, Vector3d::Zero(), dt, stats);
+        return SweepResult{stats.x_final(2), stats.x_max(2), stats.x_max(1)};
+      },
+      opts);
+
+  // results are in parameter order regardless of the thread count
+  for (size_t i = 0; i < results.size();
+       i += std::max<size_t>(1, results.size() / 8)) {
+    fmt::print("Rs {:.3f} J {:.2e} psi_r {:.4f}: omega(T) {:.2f}, "
+               "max omega {:.2f}, max iq {:.2f}\n",
+               params[i].Rs, params[i].J, params[i].psi_r,
+               results[i].omega_final, results[i].omega_max,
+               results[i].iq_max);
+  }
+
+  return 0;
+}
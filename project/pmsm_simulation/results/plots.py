@@ -3,23 +3,30 @@
 import numpy as np
 import matplotlib.pyplot as plt
 import json
+import os
 
 # %%
-# load the data
-with open("pmsm_simulation.json", "r") as file:
-    data = json.load(file)
-
-# %%
-# extract the data
-t = np.array(data["t"])  # time
-
-u = {}  # input
-for uu in data["U"]:
-    u[uu] = np.array(data["U"][uu])
-
-x = {}  # state
-for xx in data["X"]:
-    x[xx] = np.array(data["X"][xx])
+# load the data, binary npz by default or json when run with --json
+if os.path.exists("pmsm_simulation.npz"):
+    data = np.load("pmsm_simulation.npz")
+
+    t = data["t"]  # time
+    u = {uu[1:]: data[uu] for uu in sorted(data.files) if uu.startswith("U")}  # input
+    x = {xx[1:]: data[xx] for xx in sorted(data.files) if xx.startswith("X")}  # state
+else:
+    with open("pmsm_simulation.json", "r") as file:
+        data = json.load(file)
+
+    # extract the data
+    t = np.array(data["t"])  # time
+
+    u = {}  # input
+    for uu in data["U"]:
+        u[uu] = np.array(data["U"][uu])
+
+    x = {}  # state
+    for xx in data["X"]:
+        x[xx] = np.array(data["X"][xx])
 
 # %%
 # load the simulation results from python
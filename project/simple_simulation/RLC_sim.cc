@@ -1,56 +1,15 @@
 #include <eigen3/Eigen/Dense>
-#include <fstream>
-#include <iostream>
-#include <nlohmann/json.hpp>
 #include <string>
 
+#include "integrators.h"       // RungeKutta4
+#include "json_writer.h"       // Streaming JSON output
+#include "lti.h"               // Exact ZOH simulation
+#include "trajectory_writer.h" // Binary trajectory output
+
 // #include <valarray>
 
 using namespace Eigen;
-using nljson = nlohmann::json;
-
-/* ---------------------------------------------------- */
-/* Function to reate a json file */
-/* ---------------------------------------------------- */
-void create_jsonfile(std::string filename, const nljson &json_obj) {
-
-  filename += ".json"; // Append .json to filename
-
-  std::ofstream file(filename);
-  if (file.is_open()) {
-    file << json_obj.dump(4); // Pretty print with 4 spaces
-    file.close();
-    std::cout << "saved to " << filename << std::endl;
-  } else {
-    std::cerr << "Unable to open file for writing" << std::endl;
-  }
-}
-
-/* ---------------------------------------------------- */
-/*! Simulators*/
-/* ---------------------------------------------------- */
-// Euler forward method
-template <typename ODE> // ODE function class
-void euler_forward(const VectorXd &t, MatrixXd &x, const VectorXd &ref,
-                   ODE &ode) {
-  for (int ii = 1; ii < t.size(); ++ii) {
-    double dt = t[ii] - t[ii - 1];
-    x.col(ii) = x.col(ii - 1) + dt * ode.fx(x.col(ii - 1), ref[ii - 1]);
-  }
-}
-
-template <typename ODE> // ODE function class
-void RungeKutta4(const VectorXd &t, MatrixXd &x, const VectorXd &ref,
-                 ODE &ode) {
-  for (int ii = 1; ii < t.size(); ++ii) {
-    double dt = t[ii] - t[ii - 1];
-    VectorXd k1 = ode.fx(x.col(ii - 1), ref[ii - 1]);
-    VectorXd k2 = ode.fx(x.col(ii - 1) + 0.5 * dt * k1, ref[ii - 1]);
-    VectorXd k3 = ode.fx(x.col(ii - 1) + 0.5 * dt * k2, ref[ii - 1]);
-    VectorXd k4 = ode.fx(x.col(ii - 1) + dt * k3, ref[ii - 1]);
-    x.col(ii) = x.col(ii - 1) + (dt / 6) * (k1 + 2 * k2 + 2 * k3 + k4);
-  }
-}
+using FixedStepSimulators::RungeKutta4;
 
 /* Ordinary differential equation class */
 class ode_fn {
@@ -62,11 +21,10 @@ public:
   MatrixXd x; // state vector
 
   // ODE function
-  MatrixXd fx(const MatrixXd &x, const double &u) {
-    MatrixXd A = MatrixXd::Zero(2, 2);
+  void fx(double, const VectorXd &x, const VectorXd &, VectorXd &xdot) const {
+    Matrix2d A;
     A << 0, 1 / C, -1 / L, -R / L;
-    // std::cout << "A: \n" << A << std::endl;
-    return A * x;
+    xdot.noalias() = A * x;
   }
 
   // set time vector
@@ -79,7 +37,7 @@ public:
     x = MatrixXd::Zero(2, t.size());
     x.col(0) = x0;
 
-    RungeKutta4(t, x, u, *this);
+    RungeKutta4(t, x, u.transpose(), *this); // one input row
   }
 };
 
@@ -94,8 +52,11 @@ VectorXd UnitStep(const VectorXd &t, const double &t0) {
   return u;
 }
 
-/*! Main function */
-int main() {
+/*! Main function, usage: RLC_sim [--json] */
+int main(int argc, char *argv[]) {
+
+  // binary .npz output by default, JSON only on request (small runs)
+  bool save_json = argc > 1 && std::string(argv[1]) == "--json";
 
   ode_fn RLC;
   RLC.L = 1e-2;
@@ -113,18 +74,44 @@ int main() {
   VectorXd ref = UnitStep(RLC.t, 0.1); // input step function
 
   RLC.simulate(ref, x0); // simulate the system
+
+  // exact ZOH solution of the same linear system, fx does not use u
+  Matrix2d A;
+  A << 0, 1 / RLC.C, -1 / RLC.L, -RLC.R / RLC.L;
+  LTISystem<2, 1> lti(A, Vector2d::Zero(), RLC.t(1) - RLC.t(0));
+  MatrixXd x_zoh = lti.simulate(x0, ref.transpose());
   /* ---------------------------------------------------- */
 
   /* ---------------------------------------------------- */
-  /*! saving as the data as json file */
+  /*! saving the data as npz or json file */
   /* ---------------------------------------------------- */
-  nljson json_obj;
-  json_obj["time"] = RLC.t;
-  json_obj["ref"] = ref;
-  for (int ii = 0; ii < RLC.x.rows(); ++ii) {
-    json_obj["ode4"]["X" + std::to_string(ii + 1)] = RLC.x.row(ii);
+  if (save_json) {
+    JsonWriter json("simple_lpf");
+    json.begin_object();
+    json.field("time", RLC.t);
+    json.field("ref", ref);
+    json.key("ode4").begin_object();
+    for (int ii = 0; ii < RLC.x.rows(); ++ii) {
+      json.field("X" + std::to_string(ii + 1), RLC.x.row(ii));
+    }
+    json.end_object();
+    json.key("zoh").begin_object();
+    for (int ii = 0; ii < x_zoh.rows(); ++ii) {
+      json.field("X" + std::to_string(ii + 1), x_zoh.row(ii));
+    }
+    json.end_object();
+    json.end_object();
+  } else {
+    NpzWriter npz("simple_lpf");
+    npz.write("time", RLC.t);
+    npz.write("ref", ref);
+    for (int ii = 0; ii < RLC.x.rows(); ++ii) {
+      npz.write("ode4_X" + std::to_string(ii + 1), RLC.x.row(ii));
+    }
+    for (int ii = 0; ii < x_zoh.rows(); ++ii) {
+      npz.write("zoh_X" + std::to_string(ii + 1), x_zoh.row(ii));
+    }
   }
-  create_jsonfile("simple_lpf", json_obj);
   /* ---------------------------------------------------- */
 
   /* exit */
@@ -4,23 +4,11 @@
 #include <iostream>
 #include <nlohmann/json.hpp>
 
+#include "json_writer.h" // create_jsonfile
+
 using namespace Eigen;
 using nljson = nlohmann::json;
 
-void create_jsonfile(std::string filename, const nljson &json_obj) {
-
-  filename += ".json"; // Append .json to filename
-
-  std::ofstream file(filename);
-  if (file.is_open()) {
-    file << json_obj.dump(4); // Pretty print with 4 spaces
-    file.close();
-    std::cout << "saved to " << filename << std::endl;
-  } else {
-    std::cerr << "Unable to open file for writing" << std::endl;
-  }
-}
-
 int main() {
 
   double f1 = 50.0; // frequency
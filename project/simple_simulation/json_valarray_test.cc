@@ -6,6 +6,8 @@
 #include <string>
 #include <valarray>
 
+#include "json_writer.h" // create_jsonfile
+
 using nljson = nlohmann::json;
 using Vec = std::valarray<double>;
 
@@ -19,20 +21,6 @@ Vec linspace(double start, double end, int num) {
   return vec;
 }
 
-void create_jsonfile(std::string filename, const nljson &json_obj) {
-
-  filename += ".json"; // Append .json to filename
-
-  std::ofstream file(filename);
-  if (file.is_open()) {
-    file << json_obj.dump(4); // Pretty print with 4 spaces
-    file.close();
-    std::cout << "saved to " << filename << std::endl;
-  } else {
-    std::cerr << "Unable to open file for writing" << std::endl;
-  }
-}
-
 /* Main function */
 int main() {
 
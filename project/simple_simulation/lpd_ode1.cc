@@ -1,44 +1,24 @@
 #include <cmath>
 #include <eigen3/Eigen/Dense>
-#include <fstream>
-#include <iostream>
-#include <nlohmann/json.hpp>
-#include <string>
+
+#include "integrators.h" // euler_forward
+#include "json_writer.h" // Streaming JSON output
+#include "lti.h"         // Exact ZOH simulation
 
 // #include <valarray>
 
 using namespace Eigen;
-using nljson = nlohmann::json;
-
-void create_jsonfile(std::string filename, const nljson &json_obj) {
-
-  filename += ".json"; // Append .json to filename
-
-  std::ofstream file(filename);
-  if (file.is_open()) {
-    file << json_obj.dump(4); // Pretty print with 4 spaces
-    file.close();
-    std::cout << "saved to " << filename << std::endl;
-  } else {
-    std::cerr << "Unable to open file for writing" << std::endl;
-  }
-}
+using FixedStepSimulators::euler_forward;
 
 class low_pass_filter {
 public:
   double alpha;
 
   // ode for the low pass filter
-  double f_x(double &x, double &u) { return alpha * (u - x); }
-};
-
-void euler_forward(VectorXd &t, VectorXd &x, VectorXd &ref,
-                   low_pass_filter &lpf) {
-  x[0] = 0;
-  for (int ii = 1; ii < t.size(); ++ii) {
-    x[ii] = x[ii - 1] + (t[ii] - t[ii - 1]) * lpf.f_x(x[ii - 1], ref[ii - 1]);
+  void fx(double, const VectorXd &x, const VectorXd &u, VectorXd &xdot) const {
+    xdot(0) = alpha * (u(0) - x(0));
   }
-}
+};
 
 int main() {
 
@@ -60,15 +40,26 @@ int main() {
   }
 
   // Euler forward for loop test
-  VectorXd x = VectorXd::Zero(t.size());
-  euler_forward(t, x, ref, lpf);
-
-  // saving as a json file
-  nljson json_obj;
-  json_obj["time"] = t;
-  json_obj["ref"] = ref;
-  json_obj["f(y)"]["ode1"] = x;
-  create_jsonfile("simple_lpf", json_obj);
+  MatrixXd xs = MatrixXd::Zero(1, t.size());
+  euler_forward(t, xs, ref.transpose(), lpf);
+  VectorXd x = xs.row(0).transpose();
+
+  // exact ZOH solution, x' = -alpha x + alpha u
+  LTISystem<1, 1> lti(Matrix<double, 1, 1>(-lpf.alpha),
+                      Matrix<double, 1, 1>(lpf.alpha), t[1] - t[0]);
+  VectorXd x_zoh =
+      lti.simulate(Matrix<double, 1, 1>::Zero(), ref.transpose()).transpose();
+
+  // saving as a json file, apart from RLC_sim's simple_lpf
+  JsonWriter json("lpf_ode1");
+  json.begin_object();
+  json.field("time", t);
+  json.field("ref", ref);
+  json.key("f(y)").begin_object();
+  json.field("ode1", x);
+  json.field("zoh", x_zoh);
+  json.end_object();
+  json.end_object();
 
   return 0;
 }
@@ -0,0 +1,135 @@
+#ifndef LTI_H
+#define LTI_H
+
+#include <algorithm>
+#include <eigen3/Eigen/Dense>
+#include <eigen3/unsupported/Eigen/MatrixFunctions>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace Eigen;
+
+/* ---------------------------------------------------- */
+/*! Linear time-invariant systems x' = A x + B u */
+/* ---------------------------------------------------- */
+// Exact zero-order-hold discretization, computed once from
+//   exp([A B; 0 0] dt) = [Ad Bd; 0 I],
+// so a step is x = Ad x + Bd u, with u held over the step. N states and M
+// inputs, fixed sizes keep Ad and Bd on the stack.
+//
+// Example: LTISystem<2, 1> rlc(A, B, dt);
+//          MatrixXd x = rlc.simulate(x0, u); // same layout as RungeKutta4
+template <int N = Dynamic, int M = Dynamic> class LTISystem {
+public:
+  using StateMatrix = Matrix<double, N, N>;
+  using InputMatrix = Matrix<double, N, M>;
+  using State = Matrix<double, N, 1>;
+
+  LTISystem(const StateMatrix &A, const InputMatrix &B, double dt) : dt(dt) {
+    const Index n = A.rows();
+    const Index m = B.cols();
+    MatrixXd AB = MatrixXd::Zero(n + m, n + m);
+    AB.topLeftCorner(n, n) = A * dt;
+    AB.topRightCorner(n, m) = B * dt;
+    MatrixXd E = AB.exp();
+    Ad = E.topLeftCorner(n, n);
+    Bd = E.topRightCorner(n, m);
+  }
+
+  /* One step with the input u held over dt */
+  template <typename DerivedX, typename DerivedU>
+  void step(MatrixBase<DerivedX> &x, const MatrixBase<DerivedU> &u) const {
+    x = Ad * x + Bd * u; // the product is evaluated before x is written
+  }
+
+  /* States at all samples, x.col(0) = x0 and x.col(k) is reached from
+   * x.col(k - 1) with u.col(k - 1) held, as RungeKutta4(t, x, u, ode) */
+  MatrixXd simulate(const State &x0, const MatrixXd &u) const {
+    MatrixXd x(Ad.rows(), u.cols());
+    if (u.cols() == 0)
+      return x;
+    x.col(0) = x0;
+    State xk = x0;
+    for (Index k = 1; k < u.cols(); ++k) {
+      step(xk, u.col(k - 1));
+      x.col(k) = xk;
+    }
+    return x;
+  }
+
+  /* Block form of simulate for long horizons. The samples are split into
+   * blocks of `block` steps. Each block's response from a zero state is
+   * independent and runs in parallel, the block start states follow from a
+   * short sequential scan, x_start(b + 1) = Ad^block x_start(b) + z_end(b),
+   * and the free responses Ad^j x_start(b) are added back in parallel.
+   * Throws std::invalid_argument for block < 1. */
+  MatrixXd simulate_blocked(const State &x0, const MatrixXd &u, Index block,
+                            unsigned n_threads = 0) const {
+    if (block < 1)
+      throw std::invalid_argument("simulate_blocked: block must be >= 1");
+    const Index K = u.cols();
+    const Index n = Ad.rows();
+    MatrixXd x(n, K);
+    if (K == 0)
+      return x;
+    x.col(0) = x0;
+    if (n_threads == 0)
+      n_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    // powers Ad^1 .. Ad^block, stacked column blocks
+    MatrixXd P(n, n * block);
+    P.leftCols(n) = Ad;
+    for (Index j = 1; j < block; ++j)
+      P.middleCols(j * n, n) = Ad * P.middleCols((j - 1) * n, n);
+
+    // block b covers samples [1 + b block, min(1 + (b + 1) block, K))
+    const Index n_blocks = (K - 1 + block - 1) / block;
+    auto for_blocks = [&](auto &&fn) {
+      std::vector<std::thread> pool;
+      for (unsigned w = 0; w < n_threads; ++w)
+        pool.emplace_back([&, w] {
+          for (Index b = w; b < n_blocks; b += n_threads)
+            fn(1 + b * block, std::min(1 + (b + 1) * block, K));
+        });
+      for (std::thread &th : pool)
+        th.join();
+    };
+
+    // zero-state response inside every block
+    for_blocks([&](Index s, Index e) {
+      State z = Bd * u.col(s - 1);
+      x.col(s) = z;
+      for (Index k = s + 1; k < e; ++k) {
+        step(z, u.col(k - 1));
+        x.col(k) = z;
+      }
+    });
+
+    // block start states, sequential over blocks
+    MatrixXd x_start(n, n_blocks);
+    State c = x0;
+    for (Index b = 0; b < n_blocks; ++b) {
+      x_start.col(b) = c;
+      Index s = 1 + b * block;
+      Index e = std::min(s + block, K);
+      c = x.col(e - 1) + P.middleCols((e - s - 1) * n, n) * c;
+    }
+
+    // free responses
+    for_blocks([&](Index s, Index e) {
+      const State c_b = x_start.col((s - 1) / block);
+      for (Index k = s; k < e; ++k)
+        x.col(k) += P.middleCols((k - s) * n, n) * c_b;
+    });
+
+    return x;
+  }
+
+  double dt;      // sample time
+  StateMatrix Ad; // discrete state matrix
+  InputMatrix Bd; // discrete input matrix
+};
+/* ---------------------------------------------------- */
+
+#endif // LTI_H
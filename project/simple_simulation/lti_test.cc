@@ -0,0 +1,66 @@
+#include <cstdio>
+#include <eigen3/Eigen/Dense>
+#include <stdexcept>
+#include <string>
+
+#include "lti.h" // Linear time-invariant systems
+
+using namespace Eigen;
+
+static int n_failures = 0;
+
+/* ---------------------------------------------------- */
+/* Minimal check helper */
+/* ---------------------------------------------------- */
+void check(bool ok, const std::string &what) {
+  if (!ok)
+    ++n_failures;
+  std::printf("[%s] %s\n", ok ? " OK " : "FAIL", what.c_str());
+}
+/* ---------------------------------------------------- */
+
+/* simulate_blocked matches simulate for any split of the samples */
+void test_blocked() {
+  // the RLC circuit of RLC_sim.cc, driven through a real input
+  Matrix2d A;
+  A << 0, 1e2, -1e2, -10;
+  Vector2d B(0, 1e2);
+  LTISystem<2, 1> lti(A, B, 1e-3);
+  const Vector2d x0(-1, 0);
+  MatrixXd u = MatrixXd::Random(1, 1001);
+  MatrixXd x = lti.simulate(x0, u);
+
+  // 1000 steps, blocks that do not divide them, single steps, one block
+  for (Index block : {7, 64, 1, 1000, 5000}) {
+    for (unsigned n_threads : {1u, 3u}) {
+      double err = (lti.simulate_blocked(x0, u, block, n_threads) - x)
+                       .cwiseAbs()
+                       .maxCoeff();
+      char what[96];
+      std::snprintf(what, sizeof(what),
+                    "blocks of %ld, %u thread(s), max error %.1e",
+                    static_cast<long>(block), n_threads, err);
+      check(err < 1e-12, what);
+    }
+  }
+
+  // a single sample is x0, no samples is empty
+  check(lti.simulate_blocked(x0, u.leftCols(1), 8).col(0) == x0 &&
+            lti.simulate(x0, u.leftCols(0)).cols() == 0 &&
+            lti.simulate_blocked(x0, u.leftCols(0), 8).cols() == 0,
+        "one and zero samples");
+
+  bool threw = false;
+  try {
+    lti.simulate_blocked(x0, u, 0);
+  } catch (const std::invalid_argument &) {
+    threw = true;
+  }
+  check(threw, "block size 0 is rejected");
+}
+
+int main() {
+  test_blocked();
+  std::printf("%d failure(s)\n", n_failures);
+  return n_failures == 0 ? 0 : 1;
+}
@@ -1,57 +1,17 @@
 #include <eigen3/Eigen/Dense>
-#include <fstream>
-#include <iostream>
-#include <nlohmann/json.hpp>
 #include <string>
+#include <utility>
+
+#include "integrators.h"       // euler_forward, RungeKutta4
+#include "json_writer.h"       // Streaming JSON output
+#include "signals.h"           // Input signals
+#include "trajectory_writer.h" // Binary trajectory output
 
 // #include <valarray>
 
 using namespace Eigen;
-using nljson = nlohmann::json;
-
-/* ---------------------------------------------------- */
-/* Function to reate a json file */
-/* ---------------------------------------------------- */
-void create_jsonfile(std::string filename, const nljson &json_obj) {
-
-  filename += ".json"; // Append .json to filename
-
-  std::ofstream file(filename);
-  if (file.is_open()) {
-    file << json_obj.dump(4); // Pretty print with 4 spaces
-    file.close();
-    std::cout << "saved to " << filename << std::endl;
-  } else {
-    std::cerr << "Unable to open file for writing" << std::endl;
-  }
-}
-/* ---------------------------------------------------- */
-
-/* ---------------------------------------------------- */
-/*! Simulators*/
-/* ---------------------------------------------------- */
-// Euler forward method
-template <typename ODE> // ODE function class
-void euler_forward(const VectorXd &t, MatrixXd &x, const MatrixXd &u,
-                   ODE &ode) {
-  for (int ii = 1; ii < t.size(); ++ii) {
-    double dt = t[ii] - t[ii - 1];
-    x.col(ii) = x.col(ii - 1) + dt * ode.fx(x.col(ii - 1), u.col(ii - 1));
-  }
-}
-
-template <typename ODE> // ODE function class
-void RungeKutta4(const VectorXd &t, MatrixXd &x, const MatrixXd &u, ODE &ode) {
-  for (int ii = 1; ii < t.size(); ++ii) {
-    double dt = t[ii] - t[ii - 1];
-    VectorXd k1 = ode.fx(x.col(ii - 1), u.col(ii - 1));
-    VectorXd k2 = ode.fx(x.col(ii - 1) + 0.5 * dt * k1, u.col(ii - 1));
-    VectorXd k3 = ode.fx(x.col(ii - 1) + 0.5 * dt * k2, u.col(ii - 1));
-    VectorXd k4 = ode.fx(x.col(ii - 1) + dt * k3, u.col(ii - 1));
-    x.col(ii) = x.col(ii - 1) + (dt / 6) * (k1 + 2 * k2 + 2 * k3 + k4);
-  }
-}
-/* ---------------------------------------------------- */
+using FixedStepSimulators::RungeKutta4;
+using Signals::Signal;
 
 /* ---------------------------------------------------- */
 /* electric machine class */
@@ -66,28 +26,26 @@ public:
   double J;     // inertia
 
   // vectors
-  VectorXd t; // time vector
-  MatrixXd x; // state vector (3xN), x[0] -> id, x[1] -> iq, x[2] -> omega
-  MatrixXd u; // input vector (3xN), u[0] -> vd, u[1] -> vq, u[2] -> Tl
+  VectorXd t;           // time vector
+  MatrixXd x;           // state vector (3xN), x[0] -> id, x[1] -> iq, x[2] -> w
+  Signals::Inputs u{3}; // input signals, u[0] -> vd, u[1] -> vq, u[2] -> Tl
 
   // public methods
-  MatrixXd fx(const MatrixXd &x, const MatrixXd &u); // State equations
+  void fx(double t, const VectorXd &x, const VectorXd &u,
+          VectorXd &xdot) const; // State equations
 
   void set_time(const double &start, const double &end,
                 const double &delta); // set time vector
 
   void simulate(const VectorXd &x0); // simulate the PMSM
 
-  void set_inputs(const int &input_idx, const double &val,
-                  const double &t0); // set input vector
-
-private:
-  // private methods
-  VectorXd UnitStep(const double &t0); // unit step function
+  void set_input(const int &input_idx,
+                 Signal signal); // set one input signal
 };
 
 /* Electric macnine function definitions */
-MatrixXd PMSM::fx(const MatrixXd &x, const MatrixXd &u) { // State equations
+void PMSM::fx(double, const VectorXd &x, const VectorXd &u,
+              VectorXd &xdot) const { // State equations
   // extract states
   double id = x(0);
   double iq = x(1);
@@ -108,11 +66,8 @@ MatrixXd PMSM::fx(const MatrixXd &x, const MatrixXd &u) { // State equations
                      (3 * np / 2 * (psi_r * iq + (Ld - Lq) * id * iq) -
                       Tl); // mechanical speed update
 
-  // return the state derivatives
-  MatrixXd xdot(3, 1);
+  // state derivatives
   xdot << id_dot, iq_dot, omega_dot;
-
-  return xdot;
 }
 
 void PMSM::set_time(const double &start, const double &end,
@@ -127,25 +82,17 @@ void PMSM::simulate(const VectorXd &x0) { // simulate the PMSM
   RungeKutta4(t, x, u, *this);
 }
 
-void PMSM::set_inputs(const int &input_idx, const double &val,
-                      const double &t0) { // set input vector
-  u = MatrixXd::Zero(3, t.size());
-  u.row(input_idx) = UnitStep(t0) * val;
-}
-
-VectorXd PMSM::UnitStep(const double &t0) { // unit step function
-  VectorXd u = VectorXd::Zero(t.size());    // initialize with zeros
-  for (int ii = 0; ii < t.size(); ++ii) {
-    if (t[ii] > t0) {
-      u[ii] = 1;
-    }
-  }
-  return u;
+void PMSM::set_input(const int &input_idx,
+                     Signal signal) { // set one input signal
+  u[input_idx] = std::move(signal);
 }
 /* ---------------------------------------------------- */
 
-/*! Main function */
-int main() {
+/*! Main function, usage: simple_simulation [--json] */
+int main(int argc, char *argv[]) {
+
+  // binary .npz output by default, JSON only on request (small runs)
+  bool save_json = argc > 1 && std::string(argv[1]) == "--json";
 
   PMSM pmsm; // create an instance of the PMSM class
   // set the parameters
@@ -159,24 +106,41 @@ int main() {
   /* ---------------------------------------------------- */
   /*! simulation */
   /* ---------------------------------------------------- */
-  pmsm.set_time(0, 1, 100E-6);     // set time vector
-  pmsm.set_inputs(1, 200, 0.2);    // set input vector
-  VectorXd x0 = VectorXd::Zero(3); // initial state vector
-  pmsm.simulate(x0);               // simulate the system
+  pmsm.set_time(0, 1, 100E-6);                // set time vector
+  pmsm.set_input(1, Signals::step(0.2, 200)); // vq step at 0.2 s
+  VectorXd x0 = VectorXd::Zero(3);            // initial state vector
+  pmsm.simulate(x0);                          // simulate the system
   /* ---------------------------------------------------- */
 
   /* ---------------------------------------------------- */
-  /*! saving as the data as json file */
+  /*! saving the data as npz or json file */
   /* ---------------------------------------------------- */
-  nljson json_obj;
-  json_obj["t"] = pmsm.t;
-  for (int ii = 0; ii < pmsm.u.rows(); ++ii) {
-    json_obj["U"][std::to_string(ii)] = pmsm.u.row(ii);
-  }
-  for (int ii = 0; ii < pmsm.x.rows(); ++ii) {
-    json_obj["X"][std::to_string(ii)] = pmsm.x.row(ii);
+  MatrixXd U = pmsm.u.sample(pmsm.t); // inputs at the samples, output only
+  if (save_json) {
+    JsonWriter json("pmsm_simulation");
+    json.begin_object();
+    json.field("t", pmsm.t);
+    json.key("U").begin_object();
+    for (int ii = 0; ii < U.rows(); ++ii) {
+      json.field(std::to_string(ii), U.row(ii));
+    }
+    json.end_object();
+    json.key("X").begin_object();
+    for (int ii = 0; ii < pmsm.x.rows(); ++ii) {
+      json.field(std::to_string(ii), pmsm.x.row(ii));
+    }
+    json.end_object();
+    json.end_object();
+  } else {
+    NpzWriter npz("pmsm_simulation");
+    npz.write("t", pmsm.t);
+    for (int ii = 0; ii < U.rows(); ++ii) {
+      npz.write("U" + std::to_string(ii), U.row(ii));
+    }
+    for (int ii = 0; ii < pmsm.x.rows(); ++ii) {
+      npz.write("X" + std::to_string(ii), pmsm.x.row(ii));
+    }
   }
-  create_jsonfile("pmsm_simulation", json_obj);
   /* ---------------------------------------------------- */
 
   /* exit */
@@ -5,19 +5,20 @@ import numpy as np
 import json
 
 # %%
-# load the data
-with open("build/pmsm_simulation.json", "r") as file:
-    data = json.load(file)
+# load the data (RLC_sim writes simple_lpf.npz, or .json with --json)
+data = np.load("build/simple_lpf.npz")
 
 # %%
 # data processing
 # x1_ode1 = np.array(data["ode1"]["X1"])
 # x2_ode1 = np.array(data["ode1"]["X2"])
-x1_ode4 = np.array(data["ode4"]["X1"])
-x2_ode4 = np.array(data["ode4"]["X2"])
-ref = np.array(data["ref"])
+x1_ode4 = data["ode4_X1"]
+x2_ode4 = data["ode4_X2"]
+x1_zoh = data["zoh_X1"]
+x2_zoh = data["zoh_X2"]
+ref = data["ref"]
 # f_cos = np.array(data["f(y)"]["cos"])
-tsim = np.array(data["time"])
+tsim = data["time"]
 
 #   json_obj["time"] = t;
 #   json_obj["ref"] = ref;
@@ -28,7 +29,9 @@ fig, ax = plt.subplots(2, 1, clear=True, layout="tight")
 
 # ax[0].plot(tsim, x1_ode1, label="i(t)")
 # ax[0].plot(tsim, x2_ode1, label="v(t)")
-ax[0].set_title("Ode 1")
+ax[0].plot(tsim, x1_zoh, label="i(t)")
+ax[0].plot(tsim, x2_zoh, label="v(t)")
+ax[0].set_title("Exact ZOH")
 ax[0].set_xlabel("Time [s]")
 ax[0].set_ylabel("Amplitude")
 ax[0].legend()